@@ -33,8 +33,28 @@
 
 #include <chrono>
 #include <memory>
+#include <new>
+#include <type_traits>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <fstream>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(PROFILE) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
 
-#pragma region Cu
+#pragma region ライブラリ
 
 #define forange(counter, end) forstep(counter, 0, end)
 #define forstep(counter, begin, end) forstep_type(size_t, counter, begin, end)
@@ -47,7 +67,64 @@ void errerLine(const std::string &mes)
 }
 
 /**
- * @brief ԌvsNX
+ * @brief 文字列全体を0以上の整数として読み込む
+ *
+ * @param text 文字列
+ * @param value 読み込んだ値(読み込めない場合は変更しない)
+ * @return true 読み込めた
+ * @return false 整数ではない、または範囲外
+ */
+bool parseNumber(const std::string &text, unsigned long long &value)
+{
+	if (text.empty() || text[0] < '0' || text[0] > '9')
+		return false;
+
+	errno = 0;
+	char *end = nullptr;
+	const auto result = std::strtoull(text.c_str(), &end, 10);
+	if (errno != 0 || end != text.c_str() + text.size())
+		return false;
+
+	value = result;
+	return true;
+}
+
+/**
+ * @brief 最下位の1のビットの位置
+ *
+ * @param bits 0以外のビット列
+ * @return int ビット位置
+ */
+inline int lowestBit(const uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return static_cast<int>(index);
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+/**
+ * @brief 最上位の1のビットの位置
+ *
+ * @param bits 0以外のビット列
+ * @return int ビット位置
+ */
+inline int highestBit(const uint64_t bits)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, bits);
+	return static_cast<int>(index);
+#else
+	return 63 - __builtin_clzll(bits);
+#endif
+}
+
+/**
+ * @brief 時間計測を行うクラス
  *
  */
 class Stopwatch
@@ -60,7 +137,7 @@ public:
 	Stopwatch() = default;
 
 	/**
-	 * @brief vJn
+	 * @brief 計測を開始する
 	 *
 	 */
 	inline void start() noexcept
@@ -69,7 +146,7 @@ public:
 		e = s;
 	}
 	/**
-	 * @brief v~
+	 * @brief 計測を停止する
 	 *
 	 */
 	inline void stop() noexcept
@@ -78,40 +155,40 @@ public:
 	}
 
 	/**
-	 * @brief vԂ擾(imb)
+	 * @brief 計測時間を取得する(ナノ秒)
 	 *
-	 * @return const long long v(imb)
+	 * @return long long 計測時間(ナノ秒)
 	 */
-	inline const long long nanoseconds() const noexcept { return std::chrono::duration_cast<std::chrono::nanoseconds>(e - s).count(); }
+	inline long long nanoseconds() const noexcept { return std::chrono::duration_cast<std::chrono::nanoseconds>(e - s).count(); }
 	/**
-	 * @brief vԂ擾(}CNb)
+	 * @brief 計測時間を取得する(マイクロ秒)
 	 *
-	 * @return const long long v(}CNb)
+	 * @return long long 計測時間(マイクロ秒)
 	 */
-	inline const long long microseconds() const noexcept { return std::chrono::duration_cast<std::chrono::microseconds>(e - s).count(); }
+	inline long long microseconds() const noexcept { return std::chrono::duration_cast<std::chrono::microseconds>(e - s).count(); }
 	/**
-	 * @brief vԂ擾(~b)
+	 * @brief 計測時間を取得する(ミリ秒)
 	 *
-	 * @return const long long v(~b)
+	 * @return long long 計測時間(ミリ秒)
 	 */
-	inline const long long millisecond() const noexcept { return std::chrono::duration_cast<std::chrono::milliseconds>(e - s).count(); }
+	inline long long millisecond() const noexcept { return std::chrono::duration_cast<std::chrono::milliseconds>(e - s).count(); }
 
 	/**
-	 * @brief PʕťvԂ̕𓾂(imb)
+	 * @brief 単位付きの計測時間の文字列を得る(ナノ秒)
 	 *
-	 * @return const std::string vԂ̕(imb)
+	 * @return const std::string 計測時間の文字列(ナノ秒)
 	 */
 	inline const std::string toString_ns() const { return std::to_string(nanoseconds()) + "ns"; }
 	/**
-	 * @brief PʕťvԂ̕𓾂(}CNb)
+	 * @brief 単位付きの計測時間の文字列を得る(マイクロ秒)
 	 *
-	 * @return const std::string vԂ̕(}CNb)
+	 * @return const std::string 計測時間の文字列(マイクロ秒)
 	 */
 	inline const std::string toString_us() const { return std::to_string(microseconds()) + "us"; }
 	/**
-	 * @brief PʕťvԂ̕𓾂(~b)
+	 * @brief 単位付きの計測時間の文字列を得る(ミリ秒)
 	 *
-	 * @return const std::string vԂ̕(~b)
+	 * @return const std::string 計測時間の文字列(ミリ秒)
 	 */
 	inline const std::string toString_ms() const { return std::to_string(millisecond()) + "ms"; }
 
@@ -121,7 +198,7 @@ private:
 };
 
 /**
- * @brief 莞Ԃ̌o߂mFNX
+ * @brief 一定時間の経過を確認するクラス
  *
  */
 class MilliSecTimer
@@ -139,19 +216,19 @@ public:
 	/**
 	 * @brief Construct a new Milli Sec Timer object
 	 *
-	 * @param _time ݒ莞(~b)
+	 * @param _time 設定時間(ミリ秒)
 	 */
 	MilliSecTimer(const std::chrono::milliseconds &_time) noexcept { time = _time.count(); }
 
 	/**
-	 * @brief Ԃݒ肷
+	 * @brief 時間を設定する
 	 *
-	 * @param _time ݒ莞(~b)
+	 * @param _time 設定時間(ミリ秒)
 	 */
 	void set(const std::chrono::milliseconds &_time) noexcept { time = _time.count(); }
 
 	/**
-	 * @brief ^C}[Jn
+	 * @brief タイマーを開始させる
 	 *
 	 */
 	void start() noexcept
@@ -160,97 +237,296 @@ public:
 	}
 
 	/**
-	 * @brief ݒ莞Ԍo߂𓾂
+	 * @brief 設定時間経過したかを得る
 	 *
-	 * @return true ݒ莞Ԃo߂Ă
-	 * @return false ݒ莞Ԉȓ
+	 * @return true 設定時間を経過している
+	 * @return false 設定時間以内
 	 */
-	inline const bool check() const noexcept
+	inline bool check() const noexcept
 	{
 		const auto e = std::chrono::high_resolution_clock::now();
 		return std::chrono::duration_cast<std::chrono::milliseconds>(e - s).count() >= time;
 	}
 
 	/**
-	 * @brief ݒ莞Ԍo߂𓾂
+	 * @brief 設定時間経過したかを得る
 	 *
-	 * @return true ݒ莞Ԃo߂Ă
-	 * @return false ݒ莞Ԉȓ
+	 * @return true 設定時間を経過している
+	 * @return false 設定時間以内
 	 */
 	operator bool() const noexcept { return check(); }
 
 	/**
-	 * @brief oߎԂ擾(~b)
+	 * @brief 経過時間を取得する(ミリ秒)
 	 *
-	 * @return const long long oߎ(~b)
+	 * @return long long 経過時間(ミリ秒)
 	 */
-	inline const long long interval() const noexcept
+	inline long long interval() const noexcept
 	{
 		const auto e = std::chrono::high_resolution_clock::now();
 		return std::chrono::duration_cast<std::chrono::milliseconds>(e - s).count();
 	}
 };
 
-template <class Type, size_t Size>
-class MemoryPool
+/**
+ * @brief 探索ノード用のメモリ領域
+ * 同時に探索しないAI同士で共有し、サイズは実行時に指定する
+ *
+ */
+class SearchArena
 {
+public:
+	enum class Backing : char
+	{
+		//std::malloc
+		Malloc,
+		//mmap+huge page(使えない場合はMallocに戻す)、確保時に全ページを割り当てる
+		HugePage
+	};
+
+	inline static constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
 private:
-	using Deque = std::deque<Type *>;
+	enum class Mapping : char
+	{
+		None,
+		Malloc,
+		Mmap
+	};
 
-	Type *m_data = nullptr;
+	void *m_data = nullptr;
+	size_t m_size = 0;
+	size_t m_mapped = 0;
 
-	bool isRecycle = false;
-	size_t pointer = 0;
-	Deque addr;
+	Backing m_backing;
+	Mapping m_mapping = Mapping::None;
+
+	void free()
+	{
+#ifdef __linux__
+		if (m_mapping == Mapping::Mmap)
+			munmap(m_data, m_mapped);
+#endif
+		if (m_mapping == Mapping::Malloc)
+			std::free(m_data);
+
+		m_data = nullptr;
+		m_size = 0;
+		m_mapped = 0;
+		m_mapping = Mapping::None;
+	}
 
-	MemoryPool()
+	/**
+	 * @brief huge pageで確保する
+	 * MAP_HUGETLB(事前に確保されたhuge page)、THP(madvise)の順に試す
+	 *
+	 * @return std::string 確保方法(失敗した場合は空)
+	 */
+	std::string mapHugePage(const size_t bytes)
 	{
-		uint64_t memorySize = sizeof(Type) * Size;
-		m_data = static_cast<Type *>(std::malloc(memorySize));
+#ifdef __linux__
+		const auto length = (bytes + HugePageSize - 1) / HugePageSize * HugePageSize;
+
+#ifdef MAP_HUGETLB
+		void *p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+		if (p != MAP_FAILED)
+		{
+			m_data = p;
+			m_mapped = length;
+			m_mapping = Mapping::Mmap;
+			return "hugetlb";
+		}
+#endif
 
-		errerLine("Memory Size:" + std::to_string(memorySize / 1024.0 / 1024.0) + "MB");
+		//THPは先頭がhuge page境界に揃っている必要があるため余分に確保して切り詰める
+		const auto reserveLength = length + HugePageSize;
+		void *base = mmap(nullptr, reserveLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED)
+			return "";
+
+		const auto address = reinterpret_cast<uintptr_t>(base);
+		const auto aligned = (address + HugePageSize - 1) / HugePageSize * HugePageSize;
+		if (aligned > address)
+			munmap(base, aligned - address);
+		if (aligned + length < address + reserveLength)
+			munmap(reinterpret_cast<void *>(aligned + length), address + reserveLength - aligned - length);
+
+		m_data = reinterpret_cast<void *>(aligned);
+		m_mapped = length;
+		m_mapping = Mapping::Mmap;
+
+#ifdef MADV_HUGEPAGE
+		const bool transparent = (madvise(m_data, m_mapped, MADV_HUGEPAGE) == 0);
+#else
+		const bool transparent = false;
+#endif
+		touch();
+
+		return transparent ? "thp" : "mmap";
+#else
+		(void)bytes;
+		return "";
+#endif
+	}
+
+	/**
+	 * @brief 全ページに書き込み、ページフォールトを探索前に済ませる
+	 *
+	 */
+	void touch()
+	{
+		auto p = static_cast<volatile char *>(m_data);
+		for (size_t i = 0; i < m_mapped; i += 4096)
+			p[i] = 0;
 	}
 
 public:
-	inline static std::shared_ptr<MemoryPool<Type, Size>> instance{};
+	/**
+	 * @brief Construct a new Search Arena object
+	 *
+	 * @param bytes 確保するバイト数
+	 * @param backing 確保方法
+	 */
+	SearchArena(const size_t bytes, const Backing backing = Backing::Malloc) : m_backing(backing)
+	{
+		reserve(bytes);
+	}
 
-	static void Create()
+	SearchArena(const SearchArena &) = delete;
+	SearchArena &operator=(const SearchArena &) = delete;
+
+	~SearchArena()
 	{
-		instance.reset(new MemoryPool());
+		free();
 	}
 
-	~MemoryPool()
+	/**
+	 * @brief 領域を確保し直す(以前の内容は破棄する)
+	 * 使用中のMemoryPoolはclearしてから使うこと
+	 * 確保できない場合はstd::bad_allocを投げる(容量0の領域で探索させない)
+	 *
+	 * @param bytes 確保するバイト数
+	 */
+	void reserve(const size_t bytes)
 	{
-		if (m_data != nullptr)
-			std::free(m_data);
+		if (bytes == m_size)
+			return;
+
+#ifdef __linux__
+		//mmapで確保済みなら末尾を返却して縮める(割り当て済みのページを使い続ける)
+		if (m_mapping == Mapping::Mmap && bytes <= m_mapped)
+		{
+			const auto length = std::max(HugePageSize, (bytes + HugePageSize - 1) / HugePageSize * HugePageSize);
+			if (length < m_mapped)
+			{
+				munmap(static_cast<char *>(m_data) + length, m_mapped - length);
+				m_mapped = length;
+			}
+			m_size = bytes;
+
+			errerLine("Memory Size:" + std::to_string(m_size / 1024.0 / 1024.0) + "MB");
+			return;
+		}
+#endif
+
+		free();
+
+		std::string method = "malloc";
+		if (m_backing == Backing::HugePage)
+		{
+			method = mapHugePage(bytes);
+			if (method.empty())
+				method = "malloc";
+		}
+
+		if (m_mapping == Mapping::None)
+		{
+			m_data = std::malloc(bytes);
+			if (m_data != nullptr)
+			{
+				m_mapped = bytes;
+				m_mapping = Mapping::Malloc;
+				if (m_backing == Backing::HugePage)
+					touch();
+			}
+		}
+		if (m_data == nullptr && bytes > 0)
+		{
+			errerLine("Memory Size:" + std::to_string(bytes / 1024.0 / 1024.0) + "MB " + method + " failed");
+			throw std::bad_alloc();
+		}
+		m_size = bytes;
+
+		errerLine("Memory Size:" + std::to_string(m_size / 1024.0 / 1024.0) + "MB " + method);
 	}
 
+	[[nodiscard]] inline void *data() const
+	{
+		return m_data;
+	}
+	[[nodiscard]] inline size_t size() const
+	{
+		return m_size;
+	}
+};
+
+/**
+ * @brief SearchArenaをTypeの配列として使うメモリプール
+ *
+ */
+template <class Type>
+class MemoryPool
+{
+private:
+	using Deque = std::deque<Type *>;
+
+	std::shared_ptr<SearchArena> arena;
+
+	Type *m_data = nullptr;
+	size_t m_size = 0;
+
+	bool isRecycle = false;
+	size_t pointer = 0;
+	Deque addr;
+
+public:
+	MemoryPool(const std::shared_ptr<SearchArena> &arena) : arena(arena)
+	{
+		clear();
+	}
+
+	/**
+	 * @brief 全てのノードを破棄する(領域の再確保にも追従する)
+	 *
+	 */
 	void clear()
 	{
-		isRecycle = false;
+		m_data = static_cast<Type *>(arena->data());
+		m_size = arena->size() / sizeof(Type);
+
+		isRecycle = (m_size == 0);
 		pointer = 0;
 		addr.clear();
 	}
 
 	void *get()
 	{
-		if (unlikely(isRecycle))
+		if (!addr.empty())
 		{
-			if (unlikely(addr.empty()))
-			{
-				errerLine("MemoryPool out of range");
-				return nullptr;
-			}
-
 			const auto p = addr.back();
 			addr.pop_back();
 
 			return p;
 		}
+		else if (unlikely(isRecycle))
+		{
+			errerLine("MemoryPool out of range");
+			return nullptr;
+		}
 		else
 		{
 			pointer++;
-			if (pointer >= Size)
+			if (pointer >= m_size)
 			{
 				isRecycle = true;
 			}
@@ -263,26 +539,91 @@ public:
 	{
 		addr.push_back(p);
 	}
+
+	/**
+	 * @brief 残りの確保可能数を取得する
+	 *
+	 * @return size_t 確保可能数
+	 */
+	inline size_t remain() const
+	{
+		return (isRecycle ? 0 : m_size - pointer) + addr.size();
+	}
+
+	/**
+	 * @brief 確保可能な最大数を取得する
+	 *
+	 * @return size_t 最大数
+	 */
+	inline size_t capacity() const
+	{
+		return m_size;
+	}
+
+	/**
+	 * @brief 領域の先頭から確保した数を取得する(解放済みを含む最大使用量)
+	 *
+	 * @return size_t 確保数
+	 */
+	inline size_t peak() const
+	{
+		return std::min(pointer, m_size);
+	}
 };
 
-template <size_t Size>
+/**
+ * @brief 評価値(固定小数点、下位ScoreShiftビットが小数部)
+ *
+ */
+using Score = int32_t;
+inline constexpr int ScoreShift = 8;
+inline constexpr Score ScoreOne = 1 << ScoreShift;
+
+/**
+ * @brief 評価値を実数に変換する(表示用)
+ *
+ * @param score 評価値
+ * @return double 実数値
+ */
+inline double scoreToDouble(const Score score)
+{
+	return static_cast<double>(score) / ScoreOne;
+}
+
+/**
+ * @brief exp(-x/Scale)のテーブル(固定小数点)
+ *
+ * @tparam Size テーブルの長さ
+ * @tparam Scale 減衰の基準(既定はテーブルの長さ)
+ */
+template <size_t Size, size_t Scale = Size>
 class EvaluateExp
 {
 private:
-	std::array<double, Size> m_data{};
+	//1.0を1 << Shiftとする
+	inline static constexpr int Shift = 16;
+
+	std::array<int32_t, Size> m_data{};
 
 public:
 	EvaluateExp()
 	{
 		forange(x, Size)
 		{
-			m_data[x] = exp(-static_cast<double>(x) / static_cast<double>(Size * 1));
+			m_data[x] = static_cast<int32_t>(std::lround(exp(-static_cast<double>(x) / static_cast<double>(Scale * 1)) * (1 << Shift)));
 		}
 	}
 
-	[[nodiscard]] inline double operator[](const size_t index) const
+	/**
+	 * @brief 評価値にexp(-index/Scale)を掛ける
+	 *
+	 * @param value 評価値
+	 * @param index テーブルの位置
+	 * @return Score 評価値
+	 */
+	[[nodiscard]] inline Score scale(const Score value, const size_t index) const
 	{
-		return m_data[index];
+		return static_cast<Score>((static_cast<int64_t>(value) * m_data[index]) >> Shift);
 	}
 
 	constexpr size_t size() const
@@ -308,9 +649,31 @@ private:
 
 public:
 	XoShiro128() {}
+	/**
+	 * @brief シードを指定して初期化する(splitmix64で状態を生成)
+	 *
+	 * @param seed シード
+	 */
+	XoShiro128(const uint64_t seed)
+	{
+		uint64_t x = seed;
+		const auto splitmix = [&x]() {
+			uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+			return z ^ (z >> 31);
+		};
+
+		const auto a = splitmix();
+		const auto b = splitmix();
+		m_state0 = static_cast<value_type>(a);
+		m_state1 = static_cast<value_type>(a >> 32);
+		m_state2 = static_cast<value_type>(b);
+		m_state3 = static_cast<value_type>(b >> 32);
+	}
 
 	/**
-	 * @brief 32bit̗l擾
+	 * @brief 32bitの乱数値を取得する
 	 *
 	 * @return value_type
 	 */
@@ -334,7 +697,7 @@ public:
 	}
 
 	/**
-	 * @brief [0.0, 1.0)͈̗̔͂l擾
+	 * @brief [0.0, 1.0)の範囲の乱数値を取得する
 	 *
 	 * @return float [0.0, 1.0)
 	 */
@@ -345,7 +708,7 @@ public:
 		return static_cast<float>((v >> 8) * 0x1.0p-24f);
 	}
 	/**
-	 * @brief [0.0, 1.0)͈̗̔͂l擾
+	 * @brief [0.0, 1.0)の範囲の乱数値を取得する
 	 *
 	 * @return double [0.0, 1.0)
 	 */
@@ -359,9 +722,205 @@ public:
 	}
 };
 
+/**
+ * @brief 区間ごとのサイクル数計測
+ * PROFILEを定義した場合のみ計測する(PROFILE=2でノード単位の区間も計測する)
+ * 区間は入れ子を含む(内側の区間の時間も外側に含まれる)
+ *
+ */
+class Profiler
+{
+public:
+	enum class Id : int
+	{
+		Input,
+		Think,
+		ThinkOpponent,
+		ConvertInputData,
+		SetLastCommand,
+		SearchBrew,
+		SearchLearn,
+		SearchCast,
+		SearchRest,
+		Evaluate,
+		Push,
+		Output,
+		Size
+	};
+
+#ifdef PROFILE
+	inline static constexpr bool Enabled = true;
+#else
+	inline static constexpr bool Enabled = false;
+#endif
+
+	/**
+	 * @brief スコープの開始から終了までを計測する
+	 *
+	 */
+	class Scope
+	{
+	private:
+		const Id id;
+		const uint64_t start;
+
+	public:
+		Scope(const Id id) : id(id), start(Now()) {}
+		~Scope()
+		{
+			auto &counter = turnCounters[static_cast<size_t>(id)];
+			counter.cycles += Now() - start;
+			counter.calls++;
+		}
+	};
+
+	static inline uint64_t Now()
+	{
+#if defined(PROFILE) && (defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__))
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+	}
+
+	/**
+	 * @brief 集計結果の出力先をファイルにする(未指定の場合は標準エラー出力)
+	 *
+	 * @param path ファイルパス
+	 */
+	static void Open(const std::string &path)
+	{
+		std::lock_guard<std::mutex> lock(fileMutex);
+		file = std::make_unique<std::ofstream>(path);
+	}
+
+	/**
+	 * @brief ターンの集計結果を出力し、ゲームの集計に加算する
+	 *
+	 */
+	static void EndTurn()
+	{
+		if constexpr (!Enabled)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(pendingMutex);
+			forange(i, pendingCounters.size())
+			{
+				turnCounters[i].cycles += pendingCounters[i].cycles;
+				turnCounters[i].calls += pendingCounters[i].calls;
+			}
+			pendingCounters.fill(Counter{0, 0});
+		}
+
+		Print("turn " + std::to_string(turn), turnCounters);
+
+		forange(i, gameCounters.size())
+		{
+			gameCounters[i].cycles += turnCounters[i].cycles;
+			gameCounters[i].calls += turnCounters[i].calls;
+		}
+		turnCounters.fill(Counter{0, 0});
+		turn++;
+	}
+
+	/**
+	 * @brief 呼び出したスレッドの計測結果を、次にEndTurnを呼び出すスレッドのターンの集計に加える
+	 * (別スレッドで行った処理の計測結果を出力するため)
+	 *
+	 */
+	static void Publish()
+	{
+		if constexpr (!Enabled)
+			return;
+
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		forange(i, turnCounters.size())
+		{
+			pendingCounters[i].cycles += turnCounters[i].cycles;
+			pendingCounters[i].calls += turnCounters[i].calls;
+		}
+		turnCounters.fill(Counter{0, 0});
+	}
+
+	/**
+	 * @brief ゲーム全体の集計結果を出力する
+	 *
+	 */
+	static void EndGame()
+	{
+		if constexpr (!Enabled)
+			return;
+
+		Print("game", gameCounters);
+	}
+
+private:
+	struct Counter
+	{
+		uint64_t cycles;
+		uint64_t calls;
+	};
+	using Counters = std::array<Counter, static_cast<size_t>(Id::Size)>;
+
+	inline static thread_local Counters turnCounters{};
+	inline static thread_local Counters gameCounters{};
+	inline static thread_local int turn = 0;
+
+	//他のスレッドから受け取った計測結果
+	inline static Counters pendingCounters{};
+	inline static std::mutex pendingMutex;
+
+	//出力先は全スレッドで共有する(集計結果の出力が混ざらないように排他する)
+	inline static std::unique_ptr<std::ofstream> file;
+	inline static std::mutex fileMutex;
+
+	static void Print(const std::string &title, const Counters &counters)
+	{
+		static const char *const names[] = {
+			"Input", "think", "thinkOpponent", "convertInputData", "setLastCommand",
+			"searchBrew", "searchLearn", "searchCast", "searchRest", "evaluate", "push", "Output"};
+
+		std::lock_guard<std::mutex> lock(fileMutex);
+		auto &os = (file ? static_cast<std::ostream &>(*file) : std::cerr);
+
+		const auto total = counters[static_cast<size_t>(Id::Input)].cycles + counters[static_cast<size_t>(Id::Think)].cycles + counters[static_cast<size_t>(Id::Output)].cycles;
+
+		char line[128];
+		os << "@profile " << title << std::endl;
+		std::snprintf(line, sizeof(line), "%-18s %10s %14s %12s %7s", "name", "calls", "cycles", "cycles/call", "%");
+		os << line << std::endl;
+		forange(i, counters.size())
+		{
+			const auto &counter = counters[i];
+			if (counter.calls == 0)
+				continue;
+
+			std::snprintf(line, sizeof(line), "%-18s %10llu %14llu %12.1f %7.2f", names[i],
+						  static_cast<unsigned long long>(counter.calls),
+						  static_cast<unsigned long long>(counter.cycles),
+						  static_cast<double>(counter.cycles) / counter.calls,
+						  total > 0 ? 100.0 * counter.cycles / total : 0.0);
+			os << line << std::endl;
+		}
+	}
+};
+
+#ifdef PROFILE
+#define PROFILE_SCOPE(id) const Profiler::Scope profileScope_##id(Profiler::Id::id)
+#if PROFILE >= 2
+#define PROFILE_DETAIL_SCOPE(id) PROFILE_SCOPE(id)
+#else
+#define PROFILE_DETAIL_SCOPE(id)
+#endif
+#else
+#define PROFILE_SCOPE(id)
+#define PROFILE_DETAIL_SCOPE(id)
+#endif
+
 #pragma endregion
 
-#pragma region 萔錾
+#pragma region 定数宣言
 
 namespace Object
 {
@@ -375,6 +934,7 @@ namespace Object
 	const int InventorySize = 10;
 	const int PotionLimit = 6;
 	const int LearnSize = 6;
+	const int BrewSize = 5;
 
 	enum class Operation : char
 	{
@@ -389,11 +949,24 @@ namespace Object
 
 #pragma endregion
 
-#pragma region f[^\
+#pragma region データ構造
 
-struct Tier
-{
-	using value_type = char;
+/**
+ * @brief 定数式の評価中か(C++17のためコンパイラ組み込み関数を使う)
+ *
+ */
+constexpr bool IsConstantEvaluated()
+{
+#ifdef __cpp_lib_is_constant_evaluated
+	return std::is_constant_evaluated();
+#else
+	return __builtin_is_constant_evaluated();
+#endif
+}
+
+struct Tier
+{
+	using value_type = char;
 
 	value_type tier0 = value_type();
 	value_type tier1 = value_type();
@@ -406,45 +979,95 @@ struct Tier
 	{
 	}
 
-	constexpr Tier getPlus() const
+	//4つの素材を1つの32bit整数として扱う(tier0が最下位の8bit)
+	using word_type = uint32_t;
+	//各レーンの符号ビット
+	inline static constexpr word_type SignMask = 0x80808080u;
+
+	//定数式ではレーンごとに組み立て、実行時は1回の読み書きにする(リトルエンディアンを前提)
+	constexpr word_type toWord() const
+	{
+		if (IsConstantEvaluated())
+		{
+			return static_cast<word_type>(static_cast<unsigned char>(tier0)) |
+				   (static_cast<word_type>(static_cast<unsigned char>(tier1)) << 8) |
+				   (static_cast<word_type>(static_cast<unsigned char>(tier2)) << 16) |
+				   (static_cast<word_type>(static_cast<unsigned char>(tier3)) << 24);
+		}
+
+		word_type word = 0;
+		std::memcpy(&word, this, sizeof(word));
+		return word;
+	}
+	static constexpr Tier FromWord(const word_type word)
+	{
+		if (IsConstantEvaluated())
+		{
+			return Tier(static_cast<value_type>(word & 0xFFu), static_cast<value_type>((word >> 8) & 0xFFu), static_cast<value_type>((word >> 16) & 0xFFu), static_cast<value_type>(word >> 24));
+		}
+
+		//既定コンストラクタは非トリビアルだが、複製はトリビアル(static_assertで保証)
+		Tier tier;
+		std::memcpy(static_cast<void *>(&tier), &word, sizeof(word));
+		return tier;
+	}
+
+	/**
+	 * @brief レーンごとの加算(隣のレーンに桁上がりさせない)
+	 *
+	 */
+	static constexpr word_type Add(const word_type a, const word_type b)
+	{
+		//符号ビットを除いて加算し、符号ビットは排他的論理和で求める
+		return ((a & ~SignMask) + (b & ~SignMask)) ^ ((a ^ b) & SignMask);
+	}
+
+	/**
+	 * @brief 全レーンの合計(レーンは符号付き)
+	 *
+	 */
+	static constexpr int Sum(const word_type word)
 	{
-		const value_type t0 = tier0 > 0 ? tier0 : 0;
-		const value_type t1 = tier1 > 0 ? tier1 : 0;
-		const value_type t2 = tier2 > 0 ? tier2 : 0;
-		const value_type t3 = tier3 > 0 ? tier3 : 0;
+		//128を加えて符号無しにし、2レーンずつ16bitで足してから乗算で上位に集める
+		const word_type biased = word ^ SignMask;
+		const word_type pair = (biased & 0x00FF00FFu) + ((biased >> 8) & 0x00FF00FFu);
+		return static_cast<int>((pair * 0x00010001u) >> 16) - 4 * 128;
+	}
 
-		return Tier(t0, t1, t2, t3);
+	constexpr Tier getPlus() const
+	{
+		//負のレーンを0にする
+		const word_type word = toWord();
+		const word_type negative = ((word & SignMask) >> 7) * 0xFFu;
+		return FromWord(word & ~negative);
 	}
 
-	inline value_type getSum() const
+	constexpr value_type getSum() const
 	{
-		return tier0 + tier1 + tier2 + tier3;
+		return static_cast<value_type>(Sum(toWord()));
 	}
 
-	inline value_type getScore() const
+	constexpr value_type getScore() const
 	{
-		return tier1 + tier2 + tier3;
+		return static_cast<value_type>(Sum(toWord() & 0xFFFFFF00u));
 	}
 
 	constexpr Tier operator+(const Tier &o) const
 	{
-		return Tier(
-			tier0 + o.tier0,
-			tier1 + o.tier1,
-			tier2 + o.tier2,
-			tier3 + o.tier3);
+		return FromWord(Add(toWord(), o.toWord()));
 	}
-	void operator+=(const Tier &o)
+	constexpr void operator+=(const Tier &o)
 	{
-		tier0 += o.tier0;
-		tier1 += o.tier1;
-		tier2 += o.tier2;
-		tier3 += o.tier3;
+		*this = FromWord(Add(toWord(), o.toWord()));
+	}
+	constexpr Tier operator-() const
+	{
+		return Tier(static_cast<value_type>(-tier0), static_cast<value_type>(-tier1), static_cast<value_type>(-tier2), static_cast<value_type>(-tier3));
 	}
 
 	constexpr bool operator==(const Tier &o) const
 	{
-		return (tier0 == o.tier0 && tier1 == o.tier1 && tier2 == o.tier2 && tier3 == o.tier3);
+		return toWord() == o.toWord();
 	}
 
 	constexpr bool operator<(const Tier &o) const
@@ -458,61 +1081,54 @@ struct Tier
 		return tier3 < o.tier3;
 	}
 
-	bool isAccept(const Tier &o) const
+	constexpr bool isAccept(const Tier &o) const
 	{
-		auto p = (*this) + o;
-
-		if (0 > p.tier0)
-			return false;
-		if (0 > p.tier1)
-			return false;
-		if (0 > p.tier2)
-			return false;
-		if (0 > p.tier3)
-			return false;
-
-		if (p.getSum() > Object::InventorySize)
-			return false;
+		const word_type p = Add(toWord(), o.toWord());
 
-		return true;
+		return ((p & SignMask) == 0) & (Sum(p) <= Object::InventorySize);
 	}
 };
 
+static_assert(sizeof(Tier) == sizeof(Tier::word_type));
+static_assert(std::is_trivially_copyable_v<Tier>);
+static_assert(Tier(3, -1, 0, 0) + Tier(-3, 0, 0, 1) == Tier(0, -1, 0, 1));
+static_assert(Tier(3, -1, 2, -4).getPlus() == Tier(3, 0, 2, 0));
+
 struct Magic
 {
 	/**
-	 * @brief j[NID
+	 * @brief ユニークID
 	 *
 	 */
 	int actionId = 0; // the unique ID of this spell or recipe
 	/**
-	 * @brief fރRXg
+	 * @brief 素材コスト
 	 *
 	 */
 	Tier delta; // tier ingredient change
 	/**
-	 * @brief |[V̒li
+	 * @brief ポーションの値段
 	 *
 	 */
 	int price = 0; // the price in rupees if this is a potion
 	/**
-	 * @brief Xy̐ǂݐ
+	 * @brief スペルの先読み税
 	 *
 	 */
 	int tomeIndex = 0; // the index in the tome if this is a tome spell, equal to the read-ahead tax
 	/**
-	 * @brief Xy擾ɓ肷Tier0fސ
+	 * @brief スペル取得時に入手するTier0素材数
 	 *
 	 */
 	int taxCount = 0; // the amount of taxed tier-0 ingredients you gain from learning this spell
 	/**
-	 * @brief Xy̎gp
-	 * true:gp\Afalse:gps
+	 * @brief スペルの使用可否
+	 * true:使用可能、false:使用不可
 	 */
 	bool castable = false; // 1 if this is a castable player spell
 	/**
-	 * @brief Xy̘Agp
-	 * true:gp\Afalse:gps
+	 * @brief スペルの連続使用可否
+	 * true:使用可能、false:使用不可
 	 */
 	bool repeatable = false; // 1 if this is a repeatable player spell
 };
@@ -651,18 +1267,19 @@ const std::map<Tier, size_t> BrewPotionMap{
 
 #pragma endregion
 
-#pragma region Lf[^
+#pragma region 共有データ
 
 class Input;
 
+/**
+ * @brief ゲームの状態
+ * 1ゲームにつき1つ作成し、Inputで更新してAIに渡す
+ *
+ */
 class Share
 {
 private:
-	Share() {}
-
-	inline static std::shared_ptr<Share> instance;
-
-	//ȉɕKvȃf[^L
+	//以下に必要なデータを記載
 
 	std::vector<Magic> casts;
 	std::vector<Magic> opponentCasts;
@@ -684,100 +1301,114 @@ private:
 public:
 	friend Input;
 
-	static void Create()
-	{
-		instance.reset(new Share());
-	}
-
-	static Share &Get()
-	{
-		return *instance;
-	}
+	Share() {}
 
-	//ȉɕKvgetterL
+	//以下に必要なgetterを記載
 
 	/**
-	 * @brief |[VVs擾
+	 * @brief ポーション生成レシピ取得
 	 *
-	 * @return const auto& |[VVs
+	 * @return const auto& ポーション生成レシピ
 	 */
 	const auto &getBrews() const { return brews; }
 
 	/**
-	 * @brief g̑fޕϊXy擾
+	 * @brief 自身の素材変換スペル取得
 	 *
-	 * @return const auto& fޕϊXy
+	 * @return const auto& 素材変換スペル
 	 */
 	const auto &getCasts() const { return casts; }
 	/**
-	 * @brief ̑fޕϊXy擾
+	 * @brief 相手の素材変換スペル取得
 	 *
-	 * @return const auto& ̑fޕϊXy
+	 * @return const auto& 相手の素材変換スペル
 	 */
 	const auto &getOpponentCasts() const { return opponentCasts; }
 
 	/**
-	 * @brief 擾ΏۃXyꗗ擾
+	 * @brief 取得対象スペル一覧取得
 	 *
-	 * @return const auto& 擾ΏۃXyꗗ
+	 * @return const auto& 取得対象スペル一覧
 	 */
 	const auto &getLearns() const { return learns; }
 
 	/**
-	 * @brief g̑fޏԎ擾
+	 * @brief 自身の素材所持状態取得
 	 *
-	 * @return const auto& g̑fޏ
+	 * @return const auto& 自身の素材所持状態
 	 */
 	const auto &getInventory() const { return inventory; }
 	/**
-	 * @brief ̑fޏԎ擾
+	 * @brief 相手の素材所持状態取得
 	 *
-	 * @return const auto& ̑fޏ
+	 * @return const auto& 相手の素材所持状態
 	 */
 	const auto &getOpponentInventory() const { return opponentInventory; }
 
 	/**
-	 * @brief g̃|[V쐬擾
+	 * @brief 自身のポーション作成個数取得
 	 *
-	 * @return const auto g̃|[V쐬
+	 * @return const auto 自身のポーション作成個数
 	 */
 	const auto getBrewCount() const { return brewCount; }
 	/**
-	 * @brief ̃|[V쐬擾
+	 * @brief 相手のポーション作成個数取得
 	 *
-	 * @return const auto ̃|[V쐬
+	 * @return const auto 相手のポーション作成個数
 	 */
 	const auto getOpponentBrewCount() const { return opponentBrewCount; }
 
 	/**
-	 * @brief is^[擾
+	 * @brief 進行ターン数取得
 	 *
-	 * @return const auto is^[
+	 * @return const auto 進行ターン数
 	 */
 	const auto getTurn() const { return turn; }
 
 	/**
-	 * @brief ̎gpXy擾
+	 * @brief 入力から得られない進行状況を設定する(途中の局面を単独で読み込んだ場合に使う)
+	 *
+	 * @param value 進行ターン数
+	 * @param brew 自身のポーション作成個数
+	 * @param opponentBrew 相手のポーション作成個数
+	 */
+	void setProgress(const int value, const int brew, const int opponentBrew)
+	{
+		turn = value;
+		brewCount = brew;
+		opponentBrewCount = opponentBrew;
+	}
+
+	/**
+	 * @brief 相手の使用スペル取得
 	 *
-	 * @return const auto ̎gpXy
+	 * @return const auto 相手の使用スペル
 	 */
 	const auto getOpponentOperation() const { return opponentOperation; }
 };
 
 #pragma endregion
 
-#pragma region f[^
+#pragma region データ入力
 
 class Input
 {
 private:
+	Share &share;
+	std::istream &stream;
+
 	bool eof = true;
 
+	//最初の行を受け取ってからの読み込み時間(入力待ちを含まない)
+	Stopwatch parseTime;
+	//最初の行を受け取った時刻(ターンの制限時間の起点)
+	std::chrono::high_resolution_clock::time_point arrival;
+
 	template <typename Type>
 	Type read()
 	{
 		Type value;
-		if (!std::cin >> value)
+		if (!stream >> value)
 		{
 			eof = false;
 		}
@@ -792,7 +1423,7 @@ private:
 	Type readLine()
 	{
 		Type value;
-		if (!std::getline(std::cin, value))
+		if (!std::getline(stream, value))
 		{
 			eof = false;
 		}
@@ -806,20 +1437,24 @@ private:
 
 	void ignore() const
 	{
-		std::cin.ignore();
+		stream.ignore();
 	}
 
 public:
-	Input() {}
+	/**
+	 * @brief Construct a new Input object
+	 *
+	 * @param share 読み込み先のゲームの状態
+	 * @param stream 入力
+	 */
+	Input(Share &share, std::istream &stream = std::cin) : share(share), stream(stream) {}
 
 	void first()
 	{
-		auto &share = Share::Get();
 	}
 
 	bool loop()
 	{
-		auto &share = Share::Get();
 		share.turn++;
 
 		int actionCount; // the number of spells and recipes in play
@@ -831,6 +1466,10 @@ public:
 			if (!eof)
 				return false;
 		}
+		arrival = std::chrono::high_resolution_clock::now();
+		parseTime.start();
+		//入力待ちの時間は含めない(最初の行を受け取ってから計測する)
+		PROFILE_SCOPE(Input);
 
 		const auto opponentCastsSize = share.opponentCasts.size();
 		const auto castsSize = share.casts.size();
@@ -1010,19 +1649,35 @@ public:
 			}
 		}
 
+		parseTime.stop();
+
 		return true;
 	}
+
+	/**
+	 * @brief 直前の読み込み時間を取得する
+	 *
+	 * @return const Stopwatch& 読み込み時間
+	 */
+	const Stopwatch &getParseTime() const { return parseTime; }
+
+	/**
+	 * @brief 直前のターンの最初の行を受け取った時刻を取得する
+	 *
+	 * @return std::chrono::high_resolution_clock::time_point 時刻
+	 */
+	std::chrono::high_resolution_clock::time_point getArrival() const { return arrival; }
 };
 
 #pragma endregion
 
-#pragma region [eBeB
+#pragma region ユーティリティ
 
 /**
- * @brief |[V
+ * @brief ポーション生成
  *
- * @param actionId |[VID
- * @return std::string R}h
+ * @param actionId ポーションID
+ * @return std::string コマンド
  */
 std::string CommandBrew(const int actionId)
 {
@@ -1030,21 +1685,21 @@ std::string CommandBrew(const int actionId)
 }
 
 /**
- * @brief Xys
+ * @brief スペル実行
  *
- * @param actionId XyID
- * @return std::string R}h
+ * @param actionId スペルID
+ * @return std::string コマンド
  */
 std::string CommandCast(const int actionId)
 {
 	return Object::RoundActionCast + " " + std::to_string(actionId);
 }
 /**
- * @brief Xys
+ * @brief スペル実行
  *
- * @param actionId XyID
- * @param times JԂ
- * @return std::string R}h
+ * @param actionId スペルID
+ * @param times 繰返し回数
+ * @return std::string コマンド
  */
 std::string CommandCast(const int actionId, const int times)
 {
@@ -1052,10 +1707,10 @@ std::string CommandCast(const int actionId, const int times)
 }
 
 /**
- * @brief Xy擾
+ * @brief スペル取得
  *
- * @param actionId XyID
- * @return std::string R}h
+ * @param actionId スペルID
+ * @return std::string コマンド
  */
 std::string CommandLearn(const int actionId)
 {
@@ -1063,9 +1718,9 @@ std::string CommandLearn(const int actionId)
 }
 
 /**
- * @brief XyĎgp
+ * @brief スペル再使用
  *
- * @return std::string R}h
+ * @return std::string コマンド
  */
 std::string CommandRest()
 {
@@ -1073,9 +1728,9 @@ std::string CommandRest()
 }
 
 /**
- * @brief ȂɂȂ
+ * @brief なにもしない
  *
- * @return std::string R}h
+ * @return std::string コマンド
  */
 std::string CommandWait()
 {
@@ -1158,41 +1813,41 @@ public:
 	}
 
 	/**
-	 * @brief |[V
+	 * @brief ポーション生成
 	 *
-	 * @param actionId |[VID
-	 * @return CommandPack R}h
+	 * @param actionId ポーションID
+	 * @return CommandPack コマンド
 	 */
 	inline static CommandPack Brew(const int actionId) { return CommandPack(Object::Operation::Brew, actionId); }
 
 	/**
-	 * @brief Xys
+	 * @brief スペル実行
 	 *
-	 * @param actionId XyID
-	 * @param times JԂ
-	 * @return CommandPack R}h
+	 * @param actionId スペルID
+	 * @param times 繰り返し回数
+	 * @return CommandPack コマンド
 	 */
 	inline static CommandPack Cast(const int actionId, const int times = 0) { return CommandPack(Object::Operation::Cast, actionId, times); }
 
 	/**
-	 * @brief Xy擾
+	 * @brief スペル取得
 	 *
-	 * @param actionId XyID
-	 * @return CommandPack R}h
+	 * @param actionId スペルID
+	 * @return CommandPack コマンド
 	 */
 	inline static CommandPack Learn(const int actionId) { return CommandPack(Object::Operation::Learn, actionId); }
 
 	/**
-	 * @brief XyĎgp
+	 * @brief スペル再使用
 	 *
-	 * @return CommandPack R}h
+	 * @return CommandPack コマンド
 	 */
 	inline static CommandPack Rest() { return CommandPack(Object::Operation::Rest); }
 
 	/**
-	 * @brief ȂɂȂ
+	 * @brief なにもしない
 	 *
-	 * @return CommandPack R}h
+	 * @return CommandPack コマンド
 	 */
 	inline static CommandPack Wait() { return CommandPack(Object::Operation::Wait); }
 };
@@ -1205,149 +1860,12 @@ public:
 
 struct MagicBit
 {
-	using value_type = unsigned short;
-
-	short magic = 0;
-	//0b 0000 0000 0 0000 0 0 0
-	//      |    | |    | | | +Cast:Available(0x0001)
-	//      |    | |    | | +Cast:Castable(0x0001 << 1)
-	//      |    | |    | |
-	//      |    | |    | +Brew:Available(0x0001 << 2)
-	//      |    | |    |
-	//      |    | |    +Brew:Index(0x000F << 3)
-	//      |    | |
-	//      |    | +Learn:Available(0x0001 << 7)
-	//      |    |
-	//      |    +Learn:Tax(0x000F << 8)
-	//      |
-	//      +Learn:Index(0x000F << 12)
-
-	inline void setLearnTomeIndex(const int tomeIndex)
-	{
-		const value_type shift = 12;
-		const value_type mask = 0x000F;
-		const value_type smask = (mask << shift);
-
-		const auto val = static_cast<value_type>((tomeIndex & mask) << shift);
-		magic = (magic & (~smask)) | val;
-	}
-	inline int getLearnTomeIndex() const
-	{
-		const value_type shift = 12;
-		const value_type mask = 0x000F;
-		const value_type smask = (mask << shift);
-
-		return ((magic & smask) >> shift);
-	}
-	inline void decLearnTomeIndex()
-	{
-		const value_type shift = 12;
-		const value_type mask = 0x000F;
-		const value_type smask = (mask << shift);
-
-		const auto val = static_cast<value_type>((magic & smask) - static_cast<value_type>(0x0001 << shift));
-		magic = (magic & (~smask)) | val;
-	}
-
-	inline void setLearnTaxCount(const int taxCount)
-	{
-		const value_type shift = 8;
-		const value_type mask = 0x000F;
-		const value_type smask = (mask << shift);
-
-		const auto val = static_cast<value_type>((taxCount & mask) << shift);
-		magic = (magic & (~smask)) | val;
-	}
-	inline int getLearnTaxCount() const
-	{
-		const value_type shift = 8;
-		const value_type mask = 0x000F;
-		const value_type smask = (mask << shift);
-
-		return ((magic & smask) >> shift);
-	}
-	inline void incLearnTaxCount()
-	{
-		const value_type shift = 8;
-		const value_type mask = 0x000F;
-		const value_type smask = (mask << shift);
-
-		const auto val = static_cast<value_type>((magic & smask) + static_cast<value_type>(0x0001 << shift));
-		magic = (magic & (~smask)) | val;
-	}
-
-	inline void setLearnAvailable(const bool available)
-	{
-		const value_type shift = 7;
-		const value_type mask = 0x0001;
-		const value_type smask = (mask << shift);
-
-		const auto val = static_cast<value_type>(available) << shift;
-		magic = (magic & (~smask)) | val;
-	}
-	inline bool getLearnAvailable() const
-	{
-		const value_type shift = 7;
-		const value_type mask = 0x0001;
-		const value_type smask = (mask << shift);
-
-		return ((magic & smask) > 0);
-	}
-
-	inline void setLearn(const int tomeIndex, const int taxCount, const bool value)
-	{
-		value_type val = 0;
-		val = (tomeIndex & 0x000F);
-		val = (val << 4) | (taxCount & 0x000F);
-		val = (val << 1) | (value & 0x0001);
-
-		magic = (magic & (~(0x03FF << 7))) | (val << 7);
-	}
-
-	inline void setBrewAvailable(const bool available)
-	{
-		const value_type shift = 2;
-		const value_type mask = 0x0001;
-		const value_type smask = (mask << shift);
-
-		const auto val = static_cast<value_type>(available) << shift;
-		magic = (magic & (~smask)) | val;
-	}
-	inline bool getBrewAvailable() const
-	{
-		const value_type shift = 2;
-		const value_type mask = 0x0001;
-		const value_type smask = (mask << shift);
-
-		return ((magic & smask) > 0);
-	}
-
-	inline void setBrewIndex(const int index)
-	{
-		const value_type shift = 3;
-		const value_type mask = 0x000F;
-		const value_type smask = (mask << shift);
-
-		const auto val = static_cast<value_type>(index) << shift;
-		magic = (magic & (~smask)) | val;
-	}
-	inline int getBrewIndex() const
-	{
-		const value_type shift = 3;
-		const value_type mask = 0x000F;
-		const value_type smask = (mask << shift);
-
-		return ((magic & smask) >> shift);
-	}
-	inline void decBrewIndex()
-	{
-		const value_type shift = 3;
-		const value_type mask = 0x000F;
-		const value_type smask = (mask << shift);
+	using value_type = unsigned char;
 
-		const auto val = static_cast<value_type>((magic & smask) - static_cast<value_type>(0x0001 << shift));
-		magic = (magic & (~smask)) | val;
-	}
+	value_type magic = 0;
+	//0b 0 0
+	//   | +Cast:Available(0x01)
+	//   +Cast:Castable(0x01 << 1)
 
 	inline void setCastCastable(const bool castable)
 	{
@@ -1399,134 +1917,1180 @@ struct MagicBit
 	}
 };
 
-template <int SearchTurn = 22, int TimeLimit = 45, int MemoryLimit = 19>
-class AI
+/**
+ * @brief 取得したスペルの市場の枠の位置と先読み税(スペル取得の評価に使う)
+ *
+ */
+struct LearnCost
 {
-public:
-	//inline static const int SearchTurn = 22;
-	inline static const int ChokudaiWidth = 3;
-	inline static const int SurveyTurn = 7;
-
-	inline static const auto SearchMilliseconds = std::chrono::milliseconds{TimeLimit};
-	inline static const auto SurveyMilliseconds = std::chrono::milliseconds{3};
+	int tomeIndex = 0;
+	int taxCount = 0;
+};
 
-	inline static const EvaluateExp<SearchTurn> evaluateExp;
-	inline static const EvaluateExp<48> learnExp;
+/**
+ * @brief 市場(ポーション5枠、スペル6枠)の状態
+ * 各枠は左詰めで、添字が枠の位置(ポーションのボーナス、スペルのコスト)になる
+ *
+ */
+struct Market
+{
+	inline static constexpr unsigned char Empty = 0xFF;
 
-	using MagicList = std::array<MagicBit, std::max(LearnSpellSize, std::max(CastSpellSize, BrewPostionSize))>;
+	//ポーション番号
+	std::array<unsigned char, Object::BrewSize> brews;
+	//スペル番号
+	std::array<unsigned char, Object::LearnSize> tomes;
+	//スペルに置かれた先読み税
+	std::array<unsigned char, Object::LearnSize> taxes;
 
-	template <size_t Length>
-	struct Data
+	Market()
 	{
-		Tier inventory;
-		MagicList magicList;
-		CommandPack commands[Length];
-		double score = 0;
-		short price = 0;
-		short brewCount = 0;
-		char bonus3 = 4;
-		char bonus1 = 4;
-	};
+		brews.fill(Empty);
+		tomes.fill(Empty);
+		taxes.fill(0);
+	}
 
-	using DataPack = Data<SearchTurn> *;
-	using Pool = MemoryPool<Data<SearchTurn>, (1 << MemoryLimit)>;
-	Data<SearchTurn> topData;
+	/**
+	 * @brief ポーションを取り除き、右側の枠を詰める
+	 *
+	 * @param slot 枠の位置
+	 */
+	inline void removeBrew(const size_t slot)
+	{
+		std::copy(brews.begin() + slot + 1, brews.end(), brews.begin() + slot);
+		brews.back() = Empty;
+	}
 
-	struct DataLess
+	/**
+	 * @brief スペルを取り除き、左側の枠に先読み税を置いて右側の枠を詰める
+	 *
+	 * @param slot 枠の位置
+	 */
+	inline void removeTome(const size_t slot)
 	{
-		bool operator()(const DataPack &a, const DataPack &b) const
+		forange(i, slot)
 		{
-			return a->score < b->score;
+			taxes[i]++;
 		}
-	};
-
-	using PriorityQueue = std::priority_queue<DataPack, std::vector<DataPack>, DataLess>;
-
-private:
-	int gameTurn = 0;
-	int convertCastActionId[CastSpellSize];
-	bool strongCastSet[CastSpellSize];
-	std::array<int, BrewPostionSize> opponentBrewTurn;
-	std::array<int, SearchTurn> opponentTurnScore;
-	int opponentInventoryScore;
-	int potionLimit = 6;
-
-	XoShiro128 xoshiro;
-
-	size_t learnAvailableIndex[Object::LearnSize] = {0};
+		std::copy(tomes.begin() + slot + 1, tomes.end(), tomes.begin() + slot);
+		std::copy(taxes.begin() + slot + 1, taxes.end(), taxes.begin() + slot);
+		tomes.back() = Empty;
+		taxes.back() = 0;
+	}
 
-	double (AI::*evaluate)(const size_t turn, const DataPack data, const Object::Operation operation, const MagicBit magic, const size_t index);
+	/**
+	 * @brief ポーションの枠の位置を取得する
+	 *
+	 * @param potionIndex ポーション番号
+	 * @return size_t 枠の位置(無い場合はObject::BrewSize)
+	 */
+	inline size_t brewSlot(const size_t potionIndex) const
+	{
+		return std::find(brews.cbegin(), brews.cend(), static_cast<unsigned char>(potionIndex)) - brews.cbegin();
+	}
 
 	/**
-	 * @brief ̕]֐
+	 * @brief スペルの枠の位置を取得する
 	 *
-	 * @param turn TĂ^[(Βl)
-	 * @param data s̏
-	 * @param operation e
-	 * @param magic sXy̏
-	 * @param index sXy
-	 * @return double ]l
+	 * @param learnIndex スペル番号
+	 * @return size_t 枠の位置(無い場合はObject::LearnSize)
 	 */
-	inline double evaluateMy(const size_t turn, const DataPack data, const Object::Operation operation, const MagicBit magic, const size_t index)
+	inline size_t tomeSlot(const size_t learnIndex) const
 	{
-		const double topScore = data->score;
-		double score = 0;
+		return std::find(tomes.cbegin(), tomes.cend(), static_cast<unsigned char>(learnIndex)) - tomes.cbegin();
+	}
+};
 
-		switch (operation)
-		{
-		case Object::Operation::Brew:
-			if (data->brewCount < Object::PotionLimit)
-			{
-				const auto opponentTurn = opponentBrewTurn[index];
+/**
+ * @brief 素材所持状態(合計10個以下の1001通り)の番号付け
+ *
+ */
+class InventoryIndex
+{
+public:
+	inline static constexpr size_t Size = 1001;
+	inline static constexpr size_t Invalid = Size;
 
-				if (turn <= opponentTurn)
-				{
-					score += data->price;
-				}
-				else
-				{
-					//xꍇ͌_
-					//score += data->price * evaluateExp[turn - opponentTurn];
-					score += data->price * 0.95;
-				}
+private:
+	inline static constexpr size_t Width = Object::InventorySize + 1;
 
-				//score += data->brewCount / 6.0; //{[iX
-			}
-			else
-			{
-				//data->price͍vl
-				const int pm = data->price + data->inventory.getScore();
-				const int ois = turn == 0 ? opponentInventoryScore : 0;
+	std::array<unsigned short, Width * Width * Width * Width> m_index{};
+	std::array<Tier, Size> m_tier{};
 
-				if (pm >= opponentTurnScore[turn] + ois)
-				{
-					//mȂ̂ŃCt
-					//Cxg̏ԂɂĂ͕
-					score += (1 << 16) * (SearchTurn - turn);
-				}
-				else
+public:
+	InventoryIndex()
+	{
+		m_index.fill(static_cast<unsigned short>(Invalid));
+
+		size_t n = 0;
+		forange(t0, Width)
+		{
+			forange(t1, Width - t0)
+			{
+				forange(t2, Width - t0 - t1)
 				{
-					//mȂ̂ŉȂ
-					score += 0.0;
+					forange(t3, Width - t0 - t1 - t2)
+					{
+						const Tier tier(static_cast<Tier::value_type>(t0), static_cast<Tier::value_type>(t1), static_cast<Tier::value_type>(t2), static_cast<Tier::value_type>(t3));
+						m_index[key(tier)] = static_cast<unsigned short>(n);
+						m_tier[n] = tier;
+						n++;
+					}
 				}
 			}
-			break;
-		case Object::Operation::Cast:
-			if (gameTurn + turn >= 4)
-				score += 1.0;
-			else
-				score -= 1.0;
-			break;
-		case Object::Operation::Learn:
-
-			//㔼͂܂擾Ȃ悤ɂ
-			score += learnExp[std::min(learnExp.size() - 1, gameTurn + turn)];
-			//score += learnExp[std::min(learnExp.size() - 1, turn)];
-
-			score += (magic.getLearnTaxCount() - (magic.getLearnTomeIndex())) / 3.0;
+		}
+	}
 
-			if (strongCastSet[index])
-				score += 1.0;
+	/**
+	 * @brief 素材所持状態の番号を取得する
+	 *
+	 * @param tier 素材所持状態
+	 * @return size_t 状態番号(負のTierを含む、または合計が上限を超える場合はInvalid)
+	 */
+	[[nodiscard]] inline size_t operator[](const Tier &tier) const
+	{
+		if (unlikely(!isValid(tier)))
+			return Invalid;
+		return m_index[key(tier)];
+	}
+
+	/**
+	 * @brief 状態番号から素材所持状態を取得する
+	 *
+	 * @param index 状態番号
+	 * @return const Tier& 素材所持状態
+	 */
+	[[nodiscard]] inline const Tier &tier(const size_t index) const
+	{
+		return m_tier[index];
+	}
+
+private:
+	static inline bool isValid(const Tier &tier)
+	{
+		return (tier.toWord() & Tier::SignMask) == 0 && tier.getSum() <= Object::InventorySize;
+	}
+
+	static inline size_t key(const Tier &tier)
+	{
+		return ((static_cast<size_t>(tier.tier0) * Width + tier.tier1) * Width + tier.tier2) * Width + tier.tier3;
+	}
+};
+
+/**
+ * @brief 素材所持状態からポーションを作成可能になるまでの最短ターン数
+ * 所持しているスペルのみで幅優先探索を行う(休憩は考慮しないため下限値)
+ *
+ */
+class InventoryDistance
+{
+public:
+	using value_type = unsigned char;
+
+	inline static constexpr value_type Unreachable = std::numeric_limits<value_type>::max();
+
+	inline static const InventoryIndex inventoryIndex;
+
+private:
+	std::vector<unsigned int> m_edgeBegin;
+	std::vector<unsigned short> m_edge;
+	std::vector<unsigned short> m_queue;
+
+	std::array<std::array<value_type, InventoryIndex::Size>, BrewPostionSize> m_distance{};
+
+public:
+	InventoryDistance()
+	{
+		m_edgeBegin.resize(InventoryIndex::Size + 1);
+		m_queue.resize(InventoryIndex::Size);
+	}
+
+	/**
+	 * @brief 距離表を作成する
+	 *
+	 * @param casts 所持スペル
+	 * @param brews 作成対象ポーション
+	 */
+	void build(const std::vector<Magic> &casts, const std::vector<Magic> &brews)
+	{
+		//逆向きの遷移をCSR形式で作成する
+		std::fill(m_edgeBegin.begin(), m_edgeBegin.end(), 0);
+		m_edge.clear();
+
+		const auto forEachEdge = [&](const auto &func) {
+			forange(from, InventoryIndex::Size)
+			{
+				const auto &inv = inventoryIndex.tier(from);
+				for (const auto &cast : casts)
+				{
+					auto next = inv;
+					while (next.isAccept(cast.delta))
+					{
+						next += cast.delta;
+						func(from, inventoryIndex[next]);
+
+						if (!cast.repeatable)
+							break;
+					}
+				}
+			}
+		};
+
+		forEachEdge([&](const size_t, const size_t to) { m_edgeBegin[to + 1]++; });
+		forange(i, InventoryIndex::Size)
+		{
+			m_edgeBegin[i + 1] += m_edgeBegin[i];
+		}
+
+		m_edge.resize(m_edgeBegin.back());
+		{
+			auto fill = m_edgeBegin;
+			forEachEdge([&](const size_t from, const size_t to) { m_edge[fill[to]++] = static_cast<unsigned short>(from); });
+		}
+
+		for (const auto &brew : brews)
+		{
+			const auto potionIndex = BrewPotionMap.at(brew.delta);
+			auto &distance = m_distance[potionIndex];
+			distance.fill(Unreachable);
+
+			size_t head = 0;
+			size_t tail = 0;
+			forange(i, InventoryIndex::Size)
+			{
+				if (inventoryIndex.tier(i).isAccept(brew.delta))
+				{
+					distance[i] = 0;
+					m_queue[tail++] = static_cast<unsigned short>(i);
+				}
+			}
+
+			while (head < tail)
+			{
+				const auto to = m_queue[head++];
+				const auto d = distance[to];
+				if (d + 1 >= Unreachable)
+					continue;
+
+				forstep(e, m_edgeBegin[to], m_edgeBegin[to + 1])
+				{
+					const auto from = m_edge[e];
+					if (distance[from] == Unreachable)
+					{
+						distance[from] = static_cast<value_type>(d + 1);
+						m_queue[tail++] = from;
+					}
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief ポーション作成までの最短ターン数を取得する
+	 *
+	 * @param potionIndex ポーション番号
+	 * @param inventory 素材所持状態
+	 * @return value_type 最短ターン数(到達不能または存在しない素材所持状態の場合はUnreachable)
+	 */
+	[[nodiscard]] inline value_type get(const size_t potionIndex, const Tier &inventory) const
+	{
+		const auto index = inventoryIndex[inventory];
+		if (unlikely(index == InventoryIndex::Invalid))
+			return Unreachable;
+		return m_distance[potionIndex][index];
+	}
+};
+
+/**
+ * @brief 同じ深さ・同じスペル/市場状態で優越されたノードを除外するフィルタ
+ * 素材所持状態が同じで得点が上回る(得点も同じなら評価値が以上の)ノードが既にあれば除外する
+ * 状態は64bitのハッシュでのみ区別するため、素材所持状態も同じ別の状態とハッシュが衝突すると誤って除外しうる
+ * (1ターンの登録数は高々MaxSize/2なので衝突確率は1e-7程度であり、完全な状態は保持しない)
+ *
+ */
+class DominanceFilter
+{
+private:
+	struct Entry
+	{
+		uint64_t key = 0;
+		Tier inventory;
+		short price = 0;
+		unsigned short generation = 0;
+		Score score = 0;
+	};
+
+	inline static constexpr size_t MinSize = 1 << 16;
+	inline static constexpr size_t MaxSize = 1 << 21;
+	inline static constexpr size_t ProbeLimit = 16;
+
+	std::vector<Entry> m_table;
+	size_t m_count = 0;
+	unsigned short m_generation = 1;
+	//表が上限に達して比較せずに登録したノード数
+	size_t m_unchecked = 0;
+
+	/**
+	 * @brief aがbに優越するか
+	 * 素材の合計に上限があるため、素材が多い方が実行できないスペルがある
+	 * 空き容量もTierとして比較する(全Tierで以上かつ空き容量も以上、つまり同じ素材所持状態)
+	 * 得点が同じ場合は評価値の高い方を残す
+	 *
+	 */
+	static inline bool dominate(const Tier &a, const short aPrice, const Score aScore, const Tier &b, const short bPrice, const Score bScore)
+	{
+		return a == b && (aPrice > bPrice || (aPrice == bPrice && aScore >= bScore));
+	}
+
+	void grow()
+	{
+		std::vector<Entry> table(m_table.size() * 2);
+		const auto mask = table.size() - 1;
+
+		for (const auto &entry : m_table)
+		{
+			if (entry.generation != m_generation)
+				continue;
+
+			auto pos = static_cast<size_t>(entry.key) & mask;
+			while (table[pos].generation == m_generation)
+				pos = (pos + 1) & mask;
+			table[pos] = entry;
+		}
+
+		m_table.swap(table);
+	}
+
+public:
+	DominanceFilter() : m_table(MinSize) {}
+
+	/**
+	 * @brief 登録済みのノードを全て破棄する
+	 *
+	 */
+	void clear()
+	{
+		if (m_unchecked > 0)
+		{
+			errerLine("DominanceFilter full: " + std::to_string(m_unchecked) + " nodes unchecked");
+			m_unchecked = 0;
+		}
+
+		m_count = 0;
+		m_generation++;
+		if (m_generation == 0)
+		{
+			std::fill(m_table.begin(), m_table.end(), Entry{});
+			m_generation = 1;
+		}
+	}
+
+	/**
+	 * @brief ノードを登録する
+	 *
+	 * @param key 深さとスペル/市場状態のハッシュ
+	 * @param inventory 素材所持状態
+	 * @param price 得点
+	 * @param score 評価値
+	 * @return true 登録した(探索対象)
+	 * @return false 優越されているため除外
+	 */
+	bool insert(const uint64_t key, const Tier &inventory, const short price, const Score score)
+	{
+		if (m_count * 2 >= m_table.size())
+		{
+			if (m_table.size() >= MaxSize)
+			{
+				m_unchecked++;
+				return true;
+			}
+			grow();
+		}
+
+		const auto mask = m_table.size() - 1;
+		auto pos = static_cast<size_t>(key) & mask;
+
+		forange(probe, ProbeLimit)
+		{
+			auto &entry = m_table[pos];
+			if (entry.generation != m_generation)
+			{
+				entry = Entry{key, inventory, price, m_generation, score};
+				m_count++;
+				return true;
+			}
+
+			if (entry.key == key)
+			{
+				if (dominate(entry.inventory, entry.price, entry.score, inventory, price, score))
+					return false;
+
+				if (dominate(inventory, price, score, entry.inventory, entry.price, entry.score))
+				{
+					//優越した既存ノードは以降の比較対象から外す(キューからは取り除かない)
+					entry.inventory = inventory;
+					entry.price = price;
+					entry.score = score;
+					return true;
+				}
+			}
+
+			pos = (pos + 1) & mask;
+		}
+
+		return true;
+	}
+};
+
+/**
+ * @brief 評価値を量子化したバケットによる優先度付きキュー(std::priority_queueと同じ操作を持つ)
+ * バケットは固定小数点の評価値の絶対値を1/16オクターブ単位で分け(16未満はそのまま)、ビットマップで最大のバケットを求める
+ * 最大のバケットのみヒープにして、バケット内の順序も厳密に保つ
+ * (それ以外のバケットへの追加は末尾に置くだけで、最大になった時点でヒープに加える)
+ *
+ * @tparam Type 要素の型(Score型のメンバ変数scoreを持つ)
+ * @tparam Compare 比較関数(scoreの小さい方をtrueとする)
+ */
+template <class Type, class Compare>
+class BucketQueue
+{
+private:
+	inline static constexpr size_t MantissaBits = 4;
+	//絶対値の最上位ビットは高々31(INT32_MIN)
+	inline static constexpr size_t MagnitudeSize = (32 - MantissaBits + 1) << MantissaBits;
+	inline static constexpr size_t BucketSize = MagnitudeSize * 2;
+	inline static constexpr size_t WordSize = (BucketSize + 63) / 64;
+	inline static constexpr uint16_t NoSlot = 0xFFFF;
+
+	static_assert(WordSize <= 64);
+
+	struct Bucket
+	{
+		std::vector<Type> items;
+		//先頭からヒープになっている要素数
+		size_t heap = 0;
+	};
+
+	//バケット番号ごとの格納先(未使用はNoSlot)
+	std::vector<uint16_t> m_slot;
+	std::vector<Bucket> m_buckets;
+	std::array<uint64_t, WordSize> m_bits{};
+	uint64_t m_words = 0;
+
+	size_t m_size = 0;
+	//要素を持つ最大のバケット(ヒープになっている)
+	size_t m_top = BucketSize;
+
+	static inline size_t Index(const Score score)
+	{
+		const auto value = static_cast<uint32_t>(score);
+		const auto absolute = (score < 0 ? 0u - value : value);
+
+		size_t magnitude;
+		if (absolute < (1u << MantissaBits))
+			magnitude = absolute;
+		else
+		{
+			const auto exponent = static_cast<size_t>(highestBit(absolute));
+			magnitude = ((exponent - MantissaBits + 1) << MantissaBits) | ((absolute >> (exponent - MantissaBits)) & ((1u << MantissaBits) - 1));
+		}
+
+		return score < 0 ? MagnitudeSize - 1 - magnitude : MagnitudeSize + magnitude;
+	}
+
+	Bucket &bucket(const size_t index)
+	{
+		if (m_slot.empty())
+			m_slot.assign(BucketSize, NoSlot);
+
+		auto &slot = m_slot[index];
+		if (slot == NoSlot)
+		{
+			slot = static_cast<uint16_t>(m_buckets.size());
+			m_buckets.emplace_back();
+		}
+
+		return m_buckets[slot];
+	}
+
+	size_t highest() const
+	{
+		const auto word = static_cast<size_t>(highestBit(m_words));
+		return word * 64 + static_cast<size_t>(highestBit(m_bits[word]));
+	}
+
+public:
+	[[nodiscard]] bool empty() const { return m_size == 0; }
+	[[nodiscard]] size_t size() const { return m_size; }
+
+	[[nodiscard]] const Type &top() const
+	{
+		return m_buckets[m_slot[m_top]].items.front();
+	}
+
+	void push(const Type &value)
+	{
+		const auto index = Index(value.score);
+		auto &target = bucket(index);
+		target.items.push_back(value);
+		m_size++;
+
+		if (index == m_top)
+		{
+			std::push_heap(target.items.begin(), target.items.end(), Compare());
+			target.heap++;
+		}
+		else if (m_top == BucketSize || index > m_top)
+		{
+			//最大のバケットより上は空のため、要素は1つだけ
+			m_top = index;
+			target.heap = 1;
+		}
+
+		m_bits[index / 64] |= 1ull << (index % 64);
+		m_words |= 1ull << (index / 64);
+	}
+
+	void pop()
+	{
+		auto &current = m_buckets[m_slot[m_top]];
+		std::pop_heap(current.items.begin(), current.items.end(), Compare());
+		current.items.pop_back();
+		current.heap--;
+		m_size--;
+
+		if (!current.items.empty())
+			return;
+
+		auto &word = m_bits[m_top / 64];
+		word &= ~(1ull << (m_top % 64));
+		if (word == 0)
+			m_words &= ~(1ull << (m_top / 64));
+
+		if (m_size == 0)
+		{
+			m_top = BucketSize;
+			return;
+		}
+
+		//最大でない間に追加された要素をヒープに加える
+		m_top = highest();
+		auto &next = m_buckets[m_slot[m_top]];
+		if (next.heap == 0)
+			std::make_heap(next.items.begin(), next.items.end(), Compare());
+		else
+		{
+			for (auto i = next.heap + 1; i <= next.items.size(); i++)
+				std::push_heap(next.items.begin(), next.items.begin() + i, Compare());
+		}
+		next.heap = next.items.size();
+	}
+};
+
+/**
+ * @brief 行動生成時の枝刈り(ゲームのルール上、結果が変わらない/悪化する行動のみ除外する)
+ * ビーム幅で打ち切られる順位が変わり計画の得点が下がるターンがあるため、既定では行わない
+ *
+ */
+struct Pruning
+{
+	//使用済みのスペルが無い場合の休憩(待機と同じ)を生成しない
+	bool rest = false;
+	//休憩を挟まずに続けた素材変換は、入れ替えても実行できるならスペル番号の昇順のみ生成する
+	bool castOrder = false;
+
+	/**
+	 * @brief 文字列から生成する
+	 * "all":全て、"none":無し、"rest,order":指定したもののみ
+	 *
+	 * @param text 設定文字列
+	 * @return Pruning
+	 */
+	static Pruning Parse(const std::string &text)
+	{
+		if (text == "all")
+			return Pruning{true, true};
+
+		Pruning pruning;
+		std::stringstream ss(text);
+		std::string value;
+		while (std::getline(ss, value, ','))
+		{
+			if (value == "rest")
+				pruning.rest = true;
+			else if (value == "order")
+				pruning.castOrder = true;
+			else if (value != "none")
+				errerLine("枝刈りの指定を無視します:" + value);
+		}
+
+		return pruning;
+	}
+};
+
+/**
+ * @brief Chokudaiサーチの深さごとのビーム幅
+ * 可変モードでは分岐数と残り時間から幅を増減させる
+ *
+ */
+class WidthSchedule
+{
+public:
+	enum class Mode : char
+	{
+		Fixed,
+		Adaptive
+	};
+
+	inline static constexpr int MinWidth = 1;
+	inline static constexpr int MaxWidth = 16;
+
+private:
+	Mode m_mode = Mode::Fixed;
+
+	//深さごとの基準幅(足りない深さは末尾の値を使う)
+	std::vector<int> m_base{3};
+	std::vector<int> m_width;
+
+	std::vector<double> m_branching;
+	std::vector<int> m_expand;
+	std::vector<int> m_generate;
+	double m_scale = 1.0;
+	int m_loop = 0;
+
+public:
+	WidthSchedule() = default;
+	WidthSchedule(const int width) : m_base{width} {}
+	WidthSchedule(const std::vector<int> &widths, const Mode mode = Mode::Fixed) : m_mode(mode), m_base(widths)
+	{
+		if (m_base.empty())
+			m_base.push_back(1);
+	}
+
+	/**
+	 * @brief 文字列から生成する
+	 * "3":全深さ固定、"4,4,3,2":深さごと(末尾を繰り返す)、"a:4,3":可変モード
+	 *
+	 * @param text 設定文字列
+	 * @param schedule 生成したビーム幅(読み込めない場合は変更しない)
+	 * @return true 読み込めた
+	 * @return false 幅に数値ではない値を含む、または幅が無い
+	 */
+	static bool Parse(const std::string &text, WidthSchedule &schedule)
+	{
+		Mode mode = Mode::Fixed;
+		std::string body = text;
+		if (body.size() >= 2 && body[0] == 'a' && body[1] == ':')
+		{
+			mode = Mode::Adaptive;
+			body = body.substr(2);
+		}
+
+		std::vector<int> widths;
+		std::stringstream ss(body);
+		std::string value;
+		while (std::getline(ss, value, ','))
+		{
+			if (value.empty())
+				continue;
+
+			unsigned long long width = 0;
+			if (!parseNumber(value, width))
+			{
+				errerLine("ビーム幅を読み込めません:" + text);
+				return false;
+			}
+			widths.push_back(static_cast<int>(std::clamp<unsigned long long>(width, MinWidth, MaxWidth)));
+		}
+		if (widths.empty())
+		{
+			errerLine("ビーム幅を読み込めません:" + text);
+			return false;
+		}
+
+		schedule = WidthSchedule(widths, mode);
+		return true;
+	}
+
+	/**
+	 * @brief 探索開始時に呼び出す
+	 * 可変モードで深さが前回と同じ場合は、前回の探索で調整した幅と分岐数を引き継ぐ
+	 *
+	 * @param depth 探索深さ
+	 */
+	void reset(const size_t depth)
+	{
+		m_expand.assign(depth, 0);
+		m_generate.assign(depth, 0);
+		m_loop = 0;
+
+		if (m_mode == Mode::Adaptive && m_width.size() == depth)
+			return;
+
+		m_width.resize(depth);
+		forange(i, depth)
+		{
+			m_width[i] = m_base[std::min(i, m_base.size() - 1)];
+		}
+
+		m_branching.assign(depth, 0.0);
+		m_scale = 1.0;
+	}
+
+	/**
+	 * @brief 深さのビーム幅を取得する
+	 *
+	 * @param depth 深さ
+	 * @return int ビーム幅
+	 */
+	[[nodiscard]] inline int operator[](const size_t depth) const
+	{
+		return m_width[depth];
+	}
+
+	/**
+	 * @brief 全深さの最大のビーム幅を取得する
+	 *
+	 * @return int ビーム幅
+	 */
+	[[nodiscard]] int maxWidth() const
+	{
+		return m_mode == Mode::Adaptive ? MaxWidth : *std::max_element(m_base.cbegin(), m_base.cend());
+	}
+
+	/**
+	 * @brief ノード展開の結果を記録する
+	 *
+	 * @param depth 深さ
+	 * @param generate 生成した子ノード数
+	 */
+	inline void record(const size_t depth, const size_t generate)
+	{
+		if (m_mode == Mode::Adaptive)
+		{
+			m_expand[depth]++;
+			m_generate[depth] += static_cast<int>(generate);
+		}
+	}
+
+	/**
+	 * @brief 1周の終了時に幅を更新する
+	 *
+	 * @param elapsed 経過時間(ミリ秒)
+	 * @param limit 制限時間(ミリ秒)
+	 */
+	void update(const long long elapsed, const long long limit)
+	{
+		if (m_mode != Mode::Adaptive)
+			return;
+
+		m_loop++;
+
+		//分岐数の移動平均
+		double total = 0;
+		int count = 0;
+		forange(i, m_width.size())
+		{
+			if (m_expand[i] > 0)
+			{
+				const double branching = static_cast<double>(m_generate[i]) / m_expand[i];
+				m_branching[i] = (m_branching[i] == 0 ? branching : m_branching[i] * 0.75 + branching * 0.25);
+				m_expand[i] = 0;
+				m_generate[i] = 0;
+			}
+			if (m_branching[i] > 0)
+			{
+				total += m_branching[i];
+				count++;
+			}
+		}
+
+		//残り周回数が少なければ狭め、多ければ広げる
+		if (elapsed > 0)
+		{
+			const double remain = static_cast<double>(limit - elapsed) * m_loop / elapsed;
+			const double depth = static_cast<double>(m_width.size());
+			if (remain < depth)
+				m_scale = std::max(0.25, m_scale * 0.8);
+			else if (remain > depth * 4)
+				m_scale = std::min(4.0, m_scale * 1.25);
+		}
+
+		//分岐の多い深さは狭める
+		const double mean = (count > 0 ? total / count : 0);
+		forange(i, m_width.size())
+		{
+			const double base = m_base[std::min(i, m_base.size() - 1)] * m_scale;
+			const double ratio = (m_branching[i] > 0 && mean > 0 ? std::sqrt(mean / m_branching[i]) : 1.0);
+			m_width[i] = std::clamp(static_cast<int>(std::lround(base * ratio)), MinWidth, MaxWidth);
+		}
+	}
+};
+
+/**
+ * @brief 1ターン分の探索の記録(JSON Linesでトレースファイルに出力する)
+ *
+ */
+struct SearchTrace
+{
+	struct RootMove
+	{
+		CommandPack command;
+		double score = 0;
+	};
+
+	int turn = 0;
+	//探索終了時の深さ
+	int horizon = 0;
+
+	long long parseMicroseconds = 0;
+	long long surveyMicroseconds = 0;
+	long long searchMicroseconds = 0;
+
+	size_t surveyNodes = 0;
+	//深さごとの展開ノード数
+	std::vector<size_t> depthNodes;
+
+	size_t poolCapacity = 0;
+	size_t poolPeak = 0;
+	size_t poolLive = 0;
+
+	std::vector<CommandPack> pv;
+	double score = 0;
+	std::vector<RootMove> rootMoves;
+
+	//ポーションのアクションIDと相手の作成ターン
+	std::vector<std::pair<int, int>> opponentBrewTurn;
+	std::vector<int> opponentTurnScore;
+
+	/**
+	 * @brief 1行のJSONに変換する
+	 *
+	 * @return std::string JSON
+	 */
+	std::string toJson() const
+	{
+		std::ostringstream os;
+		const auto number = [&os](const double value) {
+			if (std::isfinite(value))
+				os << value;
+			else
+				os << "null";
+		};
+
+		os << "{\"turn\":" << turn
+		   << ",\"horizon\":" << horizon
+		   << ",\"us\":{\"parse\":" << parseMicroseconds << ",\"opponent\":" << surveyMicroseconds << ",\"search\":" << searchMicroseconds << "}"
+		   << ",\"surveyNodes\":" << surveyNodes
+		   << ",\"depthNodes\":[";
+		forange(i, depthNodes.size())
+		{
+			os << (i > 0 ? "," : "") << depthNodes[i];
+		}
+		os << "],\"pool\":{\"capacity\":" << poolCapacity << ",\"peak\":" << poolPeak << ",\"live\":" << poolLive << "}";
+
+		os << ",\"score\":";
+		number(score);
+		os << ",\"pv\":[";
+		forange(i, pv.size())
+		{
+			os << (i > 0 ? "," : "") << "\"" << pv[i].getCommand() << "\"";
+		}
+		os << "],\"rootMoves\":[";
+		forange(i, rootMoves.size())
+		{
+			os << (i > 0 ? "," : "") << "{\"command\":\"" << rootMoves[i].command.getCommand() << "\",\"score\":";
+			number(rootMoves[i].score);
+			os << "}";
+		}
+		os << "],\"opponentBrewTurn\":{";
+		forange(i, opponentBrewTurn.size())
+		{
+			os << (i > 0 ? "," : "") << "\"" << opponentBrewTurn[i].first << "\":" << opponentBrewTurn[i].second;
+		}
+		os << "},\"opponentTurnScore\":[";
+		forange(i, opponentTurnScore.size())
+		{
+			os << (i > 0 ? "," : "") << opponentTurnScore[i];
+		}
+		os << "]}";
+
+		return os.str();
+	}
+};
+
+/**
+ * @brief 思考ルーチン
+ *
+ * @tparam SearchTurn 探索深さの基準(評価関数の減衰の基準、探索開始時の深さ)
+ * @tparam TimeLimit 制限時間(ミリ秒)
+ * @tparam MaxSearchTurn 探索深さの上限(時間に余裕があれば探索中に深さを伸ばす)
+ * @tparam UseBucketQueue 探査キューをBucketQueueにする(falseの場合はstd::priority_queue)
+ */
+template <int SearchTurn = 22, int TimeLimit = 45, int MaxSearchTurn = SearchTurn, bool UseBucketQueue = false>
+class AI
+{
+	static_assert(MaxSearchTurn >= SearchTurn);
+
+public:
+	//inline static const int SearchTurn = 22;
+	inline static const int ChokudaiWidth = 3;
+	inline static const int SurveyTurn = 7;
+	inline static constexpr size_t DefaultHorizon = SearchTurn;
+	inline static constexpr size_t MaxHorizon = MaxSearchTurn;
+	inline static const int DistanceTurn = 4;
+	inline static constexpr Score DistanceWeight = ScoreOne / 4;
+
+	inline static const auto SearchMilliseconds = std::chrono::milliseconds{TimeLimit};
+	inline static const auto SurveyMilliseconds = std::chrono::milliseconds{3};
+
+	inline static const EvaluateExp<MaxSearchTurn, SearchTurn> evaluateExp;
+	inline static const EvaluateExp<48> learnExp;
+	inline static const EvaluateExp<DistanceTurn + 1> distanceExp;
+
+	//勝ち確定時の1ターン当たりの加点
+	inline static constexpr Score WinScore = (1 << 16) * ScoreOne;
+	//勝ち確定の加点に、それ以外の累積分の余裕を同じだけ残して溢れないこと
+	static_assert(static_cast<int64_t>(WinScore) * MaxSearchTurn * 2 <= std::numeric_limits<Score>::max());
+
+	using MagicList = std::array<MagicBit, CastSpellSize>;
+	static_assert(CastSpellSize <= 64);
+	inline static constexpr unsigned char NoCast = 0xFF;
+
+	/**
+	 * @brief 探索ノードの状態(行動履歴を除く)
+	 *
+	 */
+	struct State
+	{
+		Tier inventory;
+		MagicList magicList;
+		//所持スペルの集合(CastSpellの番号のビット)
+		uint64_t castMask = 0;
+		Market market;
+		Score score = 0;
+		Score potential = 0;
+		short price = 0;
+		short brewCount = 0;
+		char bonus3 = 4;
+		char bonus1 = 4;
+		//直前の行動が素材変換の場合のスペル番号と繰返回数(それ以外はNoCast)
+		unsigned char lastCast = NoCast;
+		unsigned char lastCastTimes = 0;
+		//展開中の参照と探査キュー上の子ノードからの参照の数
+		int references = 1;
+	};
+	template <size_t Length>
+	struct Data : State
+	{
+		CommandPack commands[Length];
+	};
+
+	using Node = Data<MaxSearchTurn>;
+	using DataPack = Node *;
+	using Pool = MemoryPool<Node>;
+
+	//SearchArenaを指定しない場合に確保するノード数
+	inline static constexpr size_t DefaultNodeCount = 1 << 19;
+	Data<MaxSearchTurn> topData;
+
+	/**
+	 * @brief 探査キューの要素(親ノードと処理内容)
+	 * 子ノードの状態はキューから取り出した時に親ノードから生成する
+	 *
+	 */
+	struct Child
+	{
+		DataPack parent;
+		Score score;
+		Score potential;
+		//Waitの場合は親ノードそのもの(初期ノード)
+		CommandPack command;
+		unsigned char turn;
+		unsigned char index;
+	};
+
+	struct ChildLess
+	{
+		bool operator()(const Child &a, const Child &b) const
+		{
+			return a.score < b.score;
+		}
+	};
+
+	using PriorityQueue = std::conditional_t<UseBucketQueue, BucketQueue<Child, ChildLess>, std::priority_queue<Child, std::vector<Child>, ChildLess>>;
+
+#ifdef NO_MAIN
+	//ツール(Tools/*.cpp)では探索の部品を直接計測できるように公開する
+public:
+#else
+private:
+#endif
+	const Share &share;
+
+	int gameTurn = 0;
+	int convertCastActionId[CastSpellSize];
+	bool strongCastSet[CastSpellSize];
+	std::array<int, BrewPostionSize> opponentBrewTurn;
+	std::array<int, MaxSearchTurn> opponentTurnScore;
+	int opponentInventoryScore;
+	int potionLimit = 6;
+
+	XoShiro128 xoshiro;
+
+	Pool pool;
+
+	WidthSchedule searchWidth{ChokudaiWidth};
+	WidthSchedule surveyWidth{ChokudaiWidth};
+
+	std::chrono::milliseconds searchMilliseconds = SearchMilliseconds;
+	//ターンの協調的な応答期限(制限時間・展開ノード数に関係なく、探索が一定間隔で確認して打ち切る)
+	std::chrono::high_resolution_clock::time_point deadline = std::chrono::high_resolution_clock::time_point::max();
+	//外部からの探索の中断要求(nullptrの場合は中断しない)
+	const std::atomic<bool> *stopFlag = nullptr;
+
+	/**
+	 * @brief 相手の探索結果(探索スレッドから1周ごとに公開する)
+	 *
+	 */
+	struct OpponentForecast
+	{
+		std::mutex mutex;
+		//公開した回数(0:未公開)
+		std::atomic<unsigned int> version{0};
+		std::atomic<bool> done{false};
+		//公開と終了の通知(mutexで待つ)
+		std::condition_variable published;
+		std::array<int, BrewPostionSize> brewTurn;
+		std::array<int, MaxSearchTurn> turnScore;
+	};
+
+	//相手の探索の制限時間
+	std::chrono::milliseconds surveyMilliseconds = SurveyMilliseconds;
+	//相手の探索を別スレッドで行う場合のAI(自身とは別の探索用メモリを持つ)
+	std::unique_ptr<AI> surveyor;
+	//相手の探索を行うスレッド(surveyorと同じ期間だけ存在し、ターンごとの依頼を待つ)
+	std::thread surveyThread;
+	std::mutex surveyMutex;
+	std::condition_variable surveyWake;
+	//依頼した回数と終了要求(surveyMutexで保護する)
+	unsigned int surveyRequest = 0;
+	bool surveyQuit = false;
+	std::atomic<bool> surveyStop{false};
+	OpponentForecast forecast;
+	unsigned int forecastVersion = 0;
+	//別スレッドの相手の探索で確保するノード数
+	inline static constexpr size_t SurveyNodeCount = 1 << 17;
+	//ノード単位で応答期限を確認する間隔(時刻の取得を間引く)
+	inline static constexpr size_t DeadlineCheckInterval = 64;
+
+	//0の場合は制限時間で探索を打ち切る
+	size_t searchNodeBudget = 0;
+	size_t surveyNodeBudget = 0;
+	size_t expandCount = 0;
+
+	bool tracing = false;
+	SearchTrace trace;
+
+	Pruning pruning;
+
+	//探索開始時の深さと、探索中に伸ばせる深さの上限
+	size_t horizonStart = SearchTurn;
+	size_t horizonMax = MaxSearchTurn;
+	//最善の評価値がこの周回数更新されなければ深さを伸ばす
+	inline static constexpr int StallLoops = 3;
+
+	InventoryDistance inventoryDistance;
+	DominanceFilter dominanceFilter;
+
+	//子ノードを評価するための作業領域(行動履歴は探査ターンの要素のみ使う)
+	Node childData;
+
+	Score (AI::*evaluate)(const size_t turn, const DataPack data, const Object::Operation operation, const LearnCost learn, const size_t index);
+
+	/**
+	 * @brief 基準の深さまでの残りターン数(早いポーション作成や勝ちほど加点する)
+	 * 伸ばした深さでは1ターン分とする(基準の深さまでは深さを伸ばさない場合と同じ)
+	 *
+	 * @param turn 探査しているターン数(相対値)
+	 * @return Score 残りターン数
+	 */
+	static constexpr Score remainTurn(const size_t turn)
+	{
+		return turn < static_cast<size_t>(SearchTurn) ? static_cast<Score>(SearchTurn - static_cast<int>(turn)) : 1;
+	}
+
+	/**
+	 * @brief 自分の評価関数
+	 *
+	 * @param turn 探査しているターン数(相対値)
+	 * @param data 処理を行った後の状態
+	 * @param operation 処理内容
+	 * @param learn 取得したスペルの枠と先読み税(スペル取得時のみ)
+	 * @param index 処理を行ったスペル
+	 * @return Score 評価値
+	 */
+	inline Score evaluateMy(const size_t turn, const DataPack data, const Object::Operation operation, const LearnCost learn, const size_t index)
+	{
+		//前回加算したポテンシャルは累積させない
+		const Score topScore = data->score - data->potential;
+		Score score = 0;
+
+		switch (operation)
+		{
+		case Object::Operation::Brew:
+			if (data->brewCount < Object::PotionLimit)
+			{
+				const auto opponentTurn = opponentBrewTurn[index];
+
+				if (static_cast<int>(turn) <= opponentTurn)
+				{
+					score += data->price * ScoreOne;
+				}
+				else
+				{
+					//相手より遅い場合は減点
+					//score += data->price * evaluateExp[turn - opponentTurn];
+					score += data->price * ScoreOne * 19 / 20;
+				}
+
+				//score += data->brewCount / 6.0; //早期ボーナス
+			}
+			else
+			{
+				//data->priceは合計値
+				const int pm = data->price + data->inventory.getScore();
+				const int ois = turn == 0 ? opponentInventoryScore : 0;
+
+				if (pm >= opponentTurnScore[turn] + ois)
+				{
+					//勝ち確定なのでインフレさせる
+					//※インベントリの状態によっては負ける
+					score += WinScore * remainTurn(turn);
+				}
+				else
+				{
+					//負け確定なので何もしない
+					score += 0;
+				}
+			}
+			break;
+		case Object::Operation::Cast:
+			if (gameTurn + turn >= 4)
+				score += ScoreOne;
+			else
+				score -= ScoreOne;
+			break;
+		case Object::Operation::Learn:
+
+			//後半はあまり取得しないようにする
+			score += learnExp.scale(ScoreOne, std::min(learnExp.size() - 1, gameTurn + turn));
+			//score += learnExp.scale(ScoreOne, std::min(learnExp.size() - 1, turn));
+
+			score += (learn.taxCount - learn.tomeIndex) * ScoreOne / 3;
+
+			if (strongCastSet[index])
+				score += ScoreOne;
 			break;
 		case Object::Operation::Rest:
 			break;
@@ -1537,52 +3101,124 @@ private:
 			break;
 		}
 
-		//o߃^[ɂ␳
-		score = (score * evaluateExp[turn]);
+		//経過ターンによる補正
+		score = evaluateExp.scale(score, turn);
+
+		//乱数によるブレ
+		//score = score * SearchTurn + nextNoise();
 
-		//ɂu
-		//score = score * SearchTurn + xoshiro.nextFloat();
+		//ポーション作成までの距離による補正
+		data->potential = evaluateExp.scale(evaluateDistance(data), turn);
+
+		return topScore + score + data->potential;
+	}
+	/**
+	 * @brief 自分の評価関数(長期用)
+	 *
+	 * @param turn 探査しているターン数(相対値)
+	 * @param data 処理を行った後の状態
+	 * @param operation 処理内容
+	 * @param learn 取得したスペルの枠と先読み税(スペル取得時のみ)
+	 * @param index 処理を行ったスペル
+	 * @return Score 評価値
+	 */
+	inline Score evaluateMyLong(const size_t turn, const DataPack data, const Object::Operation operation, const LearnCost learn, [[maybe_unused]] const size_t index)
+	{
+		const Score topScore = data->score;
+		Score score = 0;
+
+		switch (operation)
+		{
+		case Object::Operation::Brew:
+			if (data->brewCount < Object::PotionLimit)
+			{
+				score += data->price * remainTurn(turn) * ScoreOne / 10;
+				score += data->brewCount * remainTurn(turn) * ScoreOne;
+			}
+			else
+			{
+				//後で10倍するため、先に1/10にして溢れないようにする
+				score += WinScore / 10 * remainTurn(turn);
+			}
+			break;
+		case Object::Operation::Cast:
+			if (turn >= 8)
+				score += ScoreOne;
+			else
+				score -= ScoreOne;
+			break;
+		case Object::Operation::Learn:
+
+			score += learnExp.scale(ScoreOne, std::min(learnExp.size() - 1, gameTurn + turn));
+			score += -learn.tomeIndex * ScoreOne;
+			break;
+		case Object::Operation::Rest:
+			break;
+		case Object::Operation::Wait:
+			break;
+
+		default:
+			break;
+		}
+
+		//経過ターンによる補正
+		score = evaluateExp.scale(score, static_cast<size_t>(std::max(0, static_cast<int>(turn) - 8)));
+
+		//乱数によるブレ
+		score = score * 10 + nextNoise();
+
+		return topScore + score;
+	}
+	/**
+	 * @brief ポーション作成までの距離による評価(葉ノード用のポテンシャル)
+	 *
+	 * @param data 評価するノード
+	 * @return Score 評価値
+	 */
+	inline Score evaluateDistance(const DataPack data) const
+	{
+		if (data->brewCount >= Object::PotionLimit)
+			return 0;
+
+		Score potential = 0;
+		for (const auto idx : data->market.brews)
+		{
+			if (idx == Market::Empty)
+				break;
+
+			const auto distance = inventoryDistance.get(idx, data->inventory);
+			if (distance <= DistanceTurn)
+			{
+				potential = std::max(potential, distanceExp.scale(BrewPostion[idx].price * ScoreOne, distance));
+			}
+		}
 
-		return topScore + score;
+		return (potential * DistanceWeight) >> ScoreShift;
 	}
 	/**
-	 * @brief ̕]֐(p)
+	 * @brief 評価値の乱数によるブレ
 	 *
-	 * @param turn TĂ^[(Βl)
-	 * @param data s̏
-	 * @param operation e
-	 * @param magic sXy̏
-	 * @param index sXy
-	 * @return double ]l
+	 * @return Score [0, ScoreOne)
 	 */
-	inline double evaluateMyLong(const size_t turn, const DataPack data, const Object::Operation operation, const MagicBit magic, const size_t index)
+	inline Score nextNoise()
 	{
-		const double topScore = data->score;
-		double score = 0;
+		return static_cast<Score>(xoshiro.next() >> (32 - ScoreShift));
+	}
+	inline Score evaluateOpponent([[maybe_unused]] const size_t turn, const DataPack data, const Object::Operation operation, [[maybe_unused]] const LearnCost learn, [[maybe_unused]] const size_t index)
+	{
+		const Score topScore = data->score;
+		Score score = 0;
 
 		switch (operation)
 		{
 		case Object::Operation::Brew:
-			if (data->brewCount < Object::PotionLimit)
-			{
-				score += data->price * ((SearchTurn - turn) / 10.0);
-				score += data->brewCount * (SearchTurn - turn);
-			}
-			else
-			{
-				score += (1 << 16) * (SearchTurn - turn);
-			}
+			score += data->price * 100 * ScoreOne;
 			break;
 		case Object::Operation::Cast:
-			if (turn >= 8)
-				score += 1.0;
-			else
-				score -= 1.0;
+			score += ScoreOne;
 			break;
 		case Object::Operation::Learn:
-
-			score += learnExp[std::min(learnExp.size() - 1, gameTurn + turn)];
-			score += -magic.getLearnTomeIndex();
+			score += ScoreOne / 2;
 			break;
 		case Object::Operation::Rest:
 			break;
@@ -1593,317 +3229,748 @@ private:
 			break;
 		}
 
-		//o߃^[ɂ␳
-		score = (score * evaluateExp[std::max(0, static_cast<int>(turn) - 8)]);
+		return topScore + score;
+	}
+
+	MagicList convertInputData(const std::vector<Magic> &casts)
+	{
+		PROFILE_SCOPE(ConvertInputData);
 
-		//ɂu
-		score = score * 10 + xoshiro.nextFloat();
+		MagicList magicList;
 
-		return topScore + score;
+		std::fill(convertCastActionId, convertCastActionId + CastSpellSize, 0);
+		for (const auto &cast : casts)
+		{
+			const auto idx = CastSpellMap.at(cast.delta);
+			magicList[idx].setCast(cast.castable, true);
+			convertCastActionId[idx] = cast.actionId;
+		}
+
+		return magicList;
+	}
+
+	/**
+	 * @brief 入力から市場の状態を作成する
+	 *
+	 * @return Market 市場
+	 */
+	Market convertMarket() const
+	{
+		Market market;
+		for (const auto &learn : share.getLearns())
+		{
+			market.tomes[learn.tomeIndex] = static_cast<unsigned char>(LearnSpellMap.at(learn.delta));
+			market.taxes[learn.tomeIndex] = static_cast<unsigned char>(learn.taxCount);
+		}
+
+		//入力順が枠の位置
+		const auto &brews = share.getBrews();
+		forange(i, brews.size())
+		{
+			market.brews[i] = static_cast<unsigned char>(BrewPotionMap.at(brews[i].delta));
+		}
+
+		return market;
+	}
+
+	/**
+	 * @brief 子ノードの作業領域に親ノードの状態を複製する
+	 * 行動履歴は探査キューから取り出した時に親ノードから複製するため、ここでは複製しない
+	 *
+	 * @param top 親ノード
+	 * @return Node& 作業領域
+	 */
+	inline Node &makeChild(const DataPack top)
+	{
+		static_cast<State &>(childData) = *top;
+		return childData;
 	}
-	inline double evaluateOpponent(const size_t turn, const DataPack data, const Object::Operation operation, const MagicBit magic, const size_t index)
+
+	/**
+	 * @brief 評価関数を呼び出す
+	 *
+	 */
+	inline Score callEvaluate(const size_t turn, const DataPack data, const Object::Operation operation, const LearnCost learn, const size_t index)
 	{
-		const double topScore = data->score;
-		double score = 0;
+		PROFILE_DETAIL_SCOPE(Evaluate);
+		return (this->*evaluate)(turn, data, operation, learn, index);
+	}
 
-		switch (operation)
+	/**
+	 * @brief ノードのスペル/市場状態のハッシュを取得する
+	 *
+	 * @param turn 探査ターン
+	 * @param data ノード
+	 * @return uint64_t ハッシュ
+	 */
+	static inline uint64_t stateHash(const size_t turn, const Node &data)
+	{
+		constexpr size_t Words = sizeof(MagicList) / sizeof(uint64_t);
+		constexpr size_t Rest = sizeof(MagicList) % sizeof(uint64_t);
+
+		const auto bytes = reinterpret_cast<const unsigned char *>(data.magicList.data());
+
+		uint64_t hash = 0x9E3779B97F4A7C15ull * (turn + 1);
+		const auto add = [&hash](const uint64_t value) {
+			hash = (hash ^ value) * 0xFF51AFD7ED558CCDull;
+			hash ^= (hash >> 32);
+		};
+
+		forange(i, Words)
+		{
+			uint64_t word;
+			std::memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+			add(word);
+		}
+		{
+			uint64_t word = 0;
+			std::memcpy(&word, bytes + Words * sizeof(uint64_t), Rest);
+			add(word);
+		}
+		{
+			uint64_t word = 0;
+			std::memcpy(&word, data.market.tomes.data(), Object::LearnSize);
+			add(word);
+			std::memcpy(&word, data.market.taxes.data(), Object::LearnSize);
+			add(word);
+			std::memcpy(&word, data.market.brews.data(), Object::BrewSize);
+			add(word);
+		}
+		add((static_cast<uint64_t>(data.brewCount) << 16) | (static_cast<uint64_t>(data.bonus3) << 8) | static_cast<uint64_t>(data.bonus1));
+
+		return hash;
+	}
+
+	/**
+	 * @brief 探査キューに子ノードを追加する(親ノードと処理内容のみを積む)
+	 *
+	 * @param turn 探査ターン
+	 * @param top 親ノード
+	 * @param next 処理を行った後の状態
+	 * @param index 処理を行ったスペル
+	 * @param queue 探査キュー
+	 */
+	inline void push(const size_t turn, const DataPack top, const Node &next, const size_t index, PriorityQueue &queue)
+	{
+		top->references++;
+		queue.push(Child{top, next.score, next.potential, next.commands[turn], static_cast<unsigned char>(turn), static_cast<unsigned char>(index)});
+	}
+
+	/**
+	 * @brief 次の探査キューに子ノードを追加する(優越されたノードは追加しない)
+	 *
+	 * @param turn 探査ターン
+	 * @param top 親ノード
+	 * @param next 処理を行った後の状態
+	 * @param index 処理を行ったスペル
+	 * @param nextQueue 次の探査キュー
+	 */
+	inline void pushNext(const size_t turn, const DataPack top, const Node &next, const size_t index, PriorityQueue &nextQueue)
+	{
+		PROFILE_DETAIL_SCOPE(Push);
+
+		if (dominanceFilter.insert(stateHash(turn, next), next.inventory, next.price, next.score))
+		{
+			push(turn, top, next, index, nextQueue);
+		}
+	}
+
+	/**
+	 * @brief 探査キューに初期ノードを追加する
+	 *
+	 * @param queue 探査キュー
+	 * @param node 初期ノード
+	 */
+	static inline void pushRoot(PriorityQueue &queue, const DataPack node)
+	{
+		queue.push(Child{node, node->score, node->potential, CommandPack{}, 0, 0});
+	}
+
+	/**
+	 * @brief 探査キューの要素の処理内容を適用する
+	 *
+	 * @param child 探査キューの要素
+	 * @param node 親ノードの複製
+	 */
+	inline void apply(const Child &child, Node &node) const
+	{
+		switch (child.command.getOperation())
 		{
 		case Object::Operation::Brew:
-			score += data->price * 100;
-			break;
-		case Object::Operation::Cast:
-			score += 1.0;
+			applyBrew(node, child.index);
 			break;
 		case Object::Operation::Learn:
-			score += 0.5;
+			applyLearn(node, child.index);
 			break;
-		case Object::Operation::Rest:
+		case Object::Operation::Cast:
+			applyCast(node, child.index, std::get<2>(child.command.getParam()));
 			break;
-		case Object::Operation::Wait:
+		case Object::Operation::Rest:
+			applyRest(node);
 			break;
 
 		default:
-			break;
+			//初期ノード
+			return;
 		}
 
-		return topScore + score;
+		node.commands[child.turn] = child.command;
+		node.score = child.score;
+		node.potential = child.potential;
+		node.references = 1;
 	}
 
-	MagicList convertInputData(const std::vector<Magic> &casts)
+	/**
+	 * @brief 探査キューから取り出し、子ノードを生成する
+	 * 展開後はunrefを呼び出すこと
+	 *
+	 * @param queue 探査キュー
+	 * @return DataPack 探査ノード
+	 */
+	inline DataPack pop(PriorityQueue &queue)
 	{
-		const auto &share = Share::Get();
+		const auto child = queue.top();
+		queue.pop();
 
-		const auto &learns = share.getLearns();
-		const auto &brews = share.getBrews();
+		if (child.command.getOperation() == Object::Operation::Wait)
+			return child.parent;
 
-		MagicList magicList;
-		//for (const auto &learn : learns)
-		forange(i, learns.size())
+		DataPack node = new (pool.get()) Data<MaxSearchTurn>(*child.parent);
+		apply(child, *node);
+
+		unref(child.parent);
+
+		return node;
+	}
+
+	/**
+	 * @brief ノードの参照を外す(参照が無くなれば解放する)
+	 *
+	 * @param node ノード
+	 */
+	inline void unref(const DataPack node)
+	{
+		if (--node->references == 0)
+			pool.release(node);
+	}
+
+	/**
+	 * @brief スペル取得を適用する
+	 *
+	 * @param next 適用するノード
+	 * @param slot 市場の枠の位置
+	 */
+	inline void applyLearn(Node &next, const size_t slot) const
+	{
+		const auto learnIndex = next.market.tomes[slot];
+		const int tax = next.market.taxes[slot];
+
+		next.magicList[learnIndex].setCast(true, true);
+		next.castMask |= (1ull << learnIndex);
+		next.market.removeTome(slot);
+		next.lastCast = NoCast;
+
+		next.inventory.tier0 += std::min(Object::InventorySize - next.inventory.getSum(), tax - static_cast<int>(slot));
+	}
+	/**
+	 * @brief ポーション生成を適用する
+	 *
+	 * @param next 適用するノード
+	 * @param slot 市場の枠の位置
+	 */
+	inline void applyBrew(Node &next, const size_t slot) const
+	{
+		const auto potionIndex = next.market.brews[slot];
+		next.market.removeBrew(slot);
+
+		next.inventory += BrewPostion[potionIndex].delta;
+
+		int bonus = 0;
+
+		if (slot == 0 && next.bonus3 > 0)
 		{
-			const auto idx = LearnSpellMap.at(learns[i].delta);
-			magicList[idx].setLearn(learns[i].tomeIndex, learns[i].taxCount, true);
-			learnAvailableIndex[i] = idx;
+			next.bonus3--;
+			bonus = 3;
+		}
+		else if (slot == 0 && next.bonus1 > 0)
+		{
+			next.bonus1--;
+			bonus = 1;
+		}
+		else if (slot == 1 && next.bonus1 > 0)
+		{
+			next.bonus1--;
+			bonus = 1;
 		}
 
-		forange(i, brews.size())
+		next.price += BrewPostion[potionIndex].price + bonus;
+		next.brewCount += 1;
+		next.lastCast = NoCast;
+	}
+	/**
+	 * @brief 素材変換を適用する
+	 *
+	 * @param next 適用するノード
+	 * @param castIndex スペル番号
+	 * @param times スペル繰返回数
+	 */
+	inline void applyCast(Node &next, const size_t castIndex, const int times) const
+	{
+		next.magicList[castIndex].setCastCastable(false);
+
+		forange(t, times)
+		{
+			next.inventory += CastSpell[castIndex].delta;
+		}
+		next.lastCast = static_cast<unsigned char>(castIndex);
+		next.lastCastTimes = static_cast<unsigned char>(times);
+	}
+	/**
+	 * @brief 休憩を適用する
+	 *
+	 * @param next 適用するノード
+	 */
+	inline void applyRest(Node &next) const
+	{
+		for (auto mask = next.castMask; mask != 0; mask &= (mask - 1))
 		{
-			const auto idx = BrewPotionMap.at(brews[i].delta);
-			magicList[idx].setBrewAvailable(true);
-			magicList[idx].setBrewIndex(static_cast<int>(i));
+			next.magicList[lowestBit(mask)].setCastCastable(true);
 		}
+		next.lastCast = NoCast;
+	}
 
-		std::fill(convertCastActionId, convertCastActionId + CastSpellSize, 0);
-		for (const auto &cast : casts)
+	/**
+	 * @brief 使用済みの所持スペルがあるか
+	 *
+	 * @param node ノード
+	 */
+	static inline bool hasExhausted(const Node &node)
+	{
+		for (auto mask = node.castMask; mask != 0; mask &= (mask - 1))
 		{
-			const auto idx = CastSpellMap.at(cast.delta);
-			magicList[idx].setCast(cast.castable, true);
-			convertCastActionId[idx] = cast.actionId;
+			if (!node.magicList[lowestBit(mask)].getCastCastable())
+				return true;
 		}
+		return false;
+	}
 
-		return magicList;
+	/**
+	 * @brief 直前の素材変換より前に実行しても同じ状態になるか(入れ替えた順序の方を生成する)
+	 *
+	 * @param top 探査ノード
+	 * @param castIndex スペル番号
+	 * @param times スペル繰返回数
+	 */
+	inline bool isSwappable(const Node &top, const size_t castIndex, const int times) const
+	{
+		if (!pruning.castOrder || top.lastCast == NoCast || top.lastCast <= castIndex)
+			return false;
+
+		const auto &last = CastSpell[top.lastCast].delta;
+		const auto &delta = CastSpell[castIndex].delta;
+
+		//直前の素材変換の前の状態から、castIndex→直前の素材変換の順で実行できるか
+		Tier inventory = top.inventory;
+		forange(t, top.lastCastTimes)
+		{
+			inventory += -last;
+		}
+		forange(t, times)
+		{
+			if (!inventory.isAccept(delta))
+				return false;
+			inventory += delta;
+		}
+		forange(t, top.lastCastTimes)
+		{
+			if (!inventory.isAccept(last))
+				return false;
+			inventory += last;
+		}
+
+		return true;
 	}
 
 	/**
-	 * @brief Xy擾
+	 * @brief スペル取得
 	 *
-	 * @param learnIndex Xyԍ
-	 * @param magic Xyt
-	 * @param turn T^[
-	 * @param top Tm[h
-	 * @param nextQueue ̒TL[
+	 * @param slot 市場の枠の位置
+	 * @param turn 探査ターン
+	 * @param top 探査ノード
+	 * @param nextQueue 次の探査キュー
 	 */
-	inline void searchLearn(const size_t learnIndex, const MagicBit magic, const size_t turn, const DataPack top, PriorityQueue &nextQueue)
+	inline void searchLearn(const size_t slot, const size_t turn, const DataPack top, PriorityQueue &nextQueue)
 	{
-		if (magic.getLearnAvailable())
+		const auto learnIndex = top->market.tomes[slot];
+		if (learnIndex != Market::Empty)
 		{
-			if (top->inventory.tier0 >= magic.getLearnTomeIndex())
+			if (top->inventory.tier0 >= static_cast<int>(slot))
 			{
-				DataPack next = new (Pool::instance->get()) Data<SearchTurn>(*top);
-
-				next->magicList[learnIndex].setCast(true, true);
-				next->magicList[learnIndex].setLearnAvailable(false);
+				Node &next = makeChild(top);
 
-				const auto index = magic.getLearnTomeIndex();
-				forange(i, Object::LearnSize)
-				{
-					const auto learn = learnAvailableIndex[i];
-					if (next->magicList[learn].getLearnAvailable())
-					{
-						const auto idx = next->magicList[learn].getLearnTomeIndex();
-						if (idx > index)
-						{
-							//CfbNXZ
-							next->magicList[learn].decLearnTomeIndex();
-						}
-						else
-						{
-							//ǂݐŉZ
-							next->magicList[learn].incLearnTaxCount();
-						}
-					}
-				}
+				const LearnCost learn{static_cast<int>(slot), top->market.taxes[slot]};
 
-				next->inventory.tier0 += std::min(Object::InventorySize - next->inventory.getSum(), magic.getLearnTaxCount() - index);
+				applyLearn(next, slot);
 
-				next->commands[turn] = CommandPack::Learn(LearnSpell[learnIndex].actionId);
+				next.commands[turn] = CommandPack::Learn(LearnSpell[learnIndex].actionId);
 
-				next->score = (this->*evaluate)(turn, next, Object::Operation::Learn, magic, learnIndex);
+				next.score = callEvaluate(turn, &next, Object::Operation::Learn, learn, learnIndex);
 
-				nextQueue.push(next);
+				pushNext(turn, top, next, slot, nextQueue);
 			}
 		}
 	}
 	/**
-	 * @brief |[V
+	 * @brief ポーション生成
 	 *
-	 * @param potionIndex Xyԍ
-	 * @param magic Xyt
-	 * @param turn T^[
-	 * @param top Tm[h
-	 * @param nextQueue ̒TL[
+	 * @param slot 市場の枠の位置
+	 * @param turn 探査ターン
+	 * @param top 探査ノード
+	 * @param nextQueue 次の探査キュー
+	 * @param lastQueue 最終の探査キュー
 	 */
-	inline void searchBrew(const size_t potionIndex, const MagicBit magic, const size_t turn, const DataPack top, PriorityQueue &nextQueue, PriorityQueue &lastQueue)
+	inline void searchBrew(const size_t slot, const size_t turn, const DataPack top, PriorityQueue &nextQueue, PriorityQueue &lastQueue)
 	{
-		if (magic.getBrewAvailable())
+		const auto potionIndex = top->market.brews[slot];
+		if (potionIndex != Market::Empty)
 		{
 			if (top->inventory.isAccept(BrewPostion[potionIndex].delta))
 			{
-				DataPack next = new (Pool::instance->get()) Data<SearchTurn>(*top);
+				Node &next = makeChild(top);
 
-				next->magicList[potionIndex].setBrewAvailable(false);
-				const int index = next->magicList[potionIndex].getBrewIndex();
+				applyBrew(next, slot);
 
-				forange(i, next->magicList.size())
-				{
-					if (next->magicList[i].getLearnAvailable())
-					{
-						const auto idx = next->magicList[i].getLearnTomeIndex();
-						if (idx > index)
-						{
-							//CfbNXZ
-							next->magicList[i].decBrewIndex();
-						}
-					}
-				}
+				next.commands[turn] = CommandPack::Brew(BrewPostion[potionIndex].actionId);
 
-				next->inventory += BrewPostion[potionIndex].delta;
+				next.score = callEvaluate(turn, &next, Object::Operation::Brew, LearnCost{}, potionIndex);
 
-				int bonus = 0;
-
-				if (index == 0 && next->bonus3 > 0)
-				{
-					next->bonus3--;
-					bonus = 3;
-				}
-				else if (index == 0 && next->bonus1 > 0)
+				if (next.brewCount < potionLimit)
 				{
-					next->bonus1--;
-					bonus = 1;
+					pushNext(turn, top, next, slot, nextQueue);
 				}
-				else if (index == 1 && next->bonus1 > 0)
+				else
 				{
-					next->bonus1--;
-					bonus = 1;
+					push(turn, top, next, slot, lastQueue);
 				}
+			}
+		}
+	}
+	/**
+	 * @brief 素材変換
+	 *
+	 * @param castIndex スペル番号
+	 * @param magic スペル付加情報
+	 * @param turn 探査ターン
+	 * @param top 探査ノード
+	 * @param nextQueue 次の探査キュー
+	 */
+	inline void searchCast(const size_t castIndex, const MagicBit magic, const size_t turn, const DataPack top, PriorityQueue &nextQueue)
+	{
+		if (magic.getCastable())
+		{
+			const auto &delta = CastSpell[castIndex].delta;
+			if (top->inventory.isAccept(delta))
+			{
+				Node &next = makeChild(top);
 
-				next->price += BrewPostion[potionIndex].price + bonus;
-				next->brewCount += 1;
+				applyCast(next, castIndex, 1);
 
-				next->commands[turn] = CommandPack::Brew(BrewPostion[potionIndex].actionId);
+				next.commands[turn] = CommandPack::Cast(convertCastActionId[CastSpell[castIndex].actionId], 1);
 
-				next->score = (this->*evaluate)(turn, next, Object::Operation::Brew, magic, potionIndex);
+				next.score = callEvaluate(turn, &next, Object::Operation::Cast, LearnCost{}, castIndex);
 
-				if (next->brewCount < potionLimit)
-				{
-					nextQueue.push(next);
-				}
-				else
+				const auto push = [&](const int times) {
+					if (!isSwappable(*top, castIndex, times))
+					{
+						next.lastCastTimes = static_cast<unsigned char>(times);
+						pushNext(turn, top, next, castIndex, nextQueue);
+					}
+				};
+
+				push(1);
+
+				if (CastSpell[castIndex].repeatable)
 				{
-					lastQueue.push(next);
+					//評価値は1回目と同じ
+					int times = 2;
+					while (next.inventory.isAccept(delta))
+					{
+						next.inventory += delta;
+
+						next.commands[turn] = CommandPack::Cast(convertCastActionId[CastSpell[castIndex].actionId], times);
+
+						push(times);
+
+						times++;
+					}
 				}
 			}
 		}
 	}
 	/**
-	 * @brief fޕϊ
+	 * @brief 素材変換
+	 *
+	 * @param castIndex スペル番号
+	 * @param times スペル繰返回数
+	 * @param magic スペル付加情報
+	 * @param turn 探査ターン
+	 * @param top 探査ノード
+	 * @param nextQueue 次の探査キュー
+	 */
+	inline void searchCast(const size_t castIndex, const int times, const MagicBit magic, const size_t turn, const DataPack top, PriorityQueue &nextQueue)
+	{
+		if (magic.getCastable())
+		{
+			//繰返回数分の素材が足りること(前回の最善手は現在の素材で実行できるとは限らない)
+			Tier inventory = top->inventory;
+			forange(t, times)
+			{
+				if (!inventory.isAccept(CastSpell[castIndex].delta))
+					return;
+				inventory += CastSpell[castIndex].delta;
+			}
+
+			{
+				Node &next = makeChild(top);
+
+				applyCast(next, castIndex, times);
+
+				next.commands[turn] = CommandPack::Cast(convertCastActionId[CastSpell[castIndex].actionId], times);
+
+				next.score = callEvaluate(turn, &next, Object::Operation::Cast, LearnCost{}, castIndex);
+
+				pushNext(turn, top, next, castIndex, nextQueue);
+			}
+		}
+	}
+	/**
+	 * @brief 休憩
+	 *
+	 * @param castIndex スペル番号
+	 * @param magic スペル付加情報
+	 * @param turn 探査ターン
+	 * @param top 探査ノード
+	 * @param nextQueue 次の探査キュー
+	 */
+	inline void searchRest(const size_t turn, const DataPack top, PriorityQueue &nextQueue)
+	{
+		Node &next = makeChild(top);
+
+		applyRest(next);
+
+		next.commands[turn] = CommandPack::Rest();
+
+		next.score = callEvaluate(turn, &next, Object::Operation::Rest, LearnCost{}, 0);
+
+		pushNext(turn, top, next, 0, nextQueue);
+	}
+
+	/**
+	 * @brief ノードを展開する
 	 *
-	 * @param castIndex Xyԍ
-	 * @param magic Xyt
-	 * @param turn T^[
-	 * @param top Tm[h
-	 * @param nextQueue ̒TL[
+	 * @param turn 探査ターン
+	 * @param top 探査ノード
+	 * @param chokudaiSearch 探査キュー
+	 * @param learn スペル取得を行うか
 	 */
-	inline void searchCast(const size_t castIndex, const MagicBit magic, const size_t turn, const DataPack top, PriorityQueue &nextQueue)
+	inline void expand(const size_t turn, const DataPack top, std::array<PriorityQueue, MaxSearchTurn + 1> &chokudaiSearch, const bool learn)
 	{
-		if (magic.getCastable())
+		const auto before = chokudaiSearch[turn + 1].size() + chokudaiSearch[MaxSearchTurn].size();
+
 		{
-			if (top->inventory.isAccept(CastSpell[castIndex].delta))
+			PROFILE_SCOPE(SearchBrew);
+			forange(i, Object::BrewSize)
 			{
-				DataPack next = new (Pool::instance->get()) Data<SearchTurn>(*top);
-
-				next->magicList[castIndex].setCastCastable(false);
-
-				next->inventory += CastSpell[castIndex].delta;
-
-				next->commands[turn] = CommandPack::Cast(convertCastActionId[CastSpell[castIndex].actionId], 1);
+				searchBrew(i, turn, top, chokudaiSearch[turn + 1], chokudaiSearch[MaxSearchTurn]);
+			}
+		}
 
-				next->score = (this->*evaluate)(turn, next, Object::Operation::Cast, magic, castIndex);
+		if (learn)
+		{
+			PROFILE_SCOPE(SearchLearn);
+			forange(i, Object::LearnSize)
+			{
+				searchLearn(i, turn, top, chokudaiSearch[turn + 1]);
+			}
+		}
 
-				nextQueue.push(next);
+		{
+			PROFILE_SCOPE(SearchCast);
+			//所持スペルのみ(番号の昇順)
+			for (auto mask = top->castMask; mask != 0; mask &= (mask - 1))
+			{
+				const auto i = static_cast<size_t>(lowestBit(mask));
+				searchCast(i, top->magicList[i], turn, top, chokudaiSearch[turn + 1]);
+			}
+		}
 
-				if (CastSpell[castIndex].repeatable)
-				{
-					int times = 2;
-					auto inv = next->inventory;
-					while (inv.isAccept(CastSpell[castIndex].delta))
-					{
-						DataPack next2 = new (Pool::instance->get()) Data<SearchTurn>(*next);
+		{
+			PROFILE_SCOPE(SearchRest);
+			//使用済みのスペルが無い休憩は、他に行動が無い場合のみ生成する
+			if (!pruning.rest || hasExhausted(*top) || chokudaiSearch[turn + 1].size() + chokudaiSearch[MaxSearchTurn].size() == before)
+				searchRest(turn, top, chokudaiSearch[turn + 1]);
+		}
+	}
 
-						inv += CastSpell[castIndex].delta;
-						next2->inventory = inv;
+	/**
+	 * @brief ノード単位で探索を打ち切るかを得る(応答期限は一定間隔で確認する)
+	 *
+	 * @param count 展開したノード数
+	 * @return true 中断の要求、または応答期限を過ぎた
+	 * @return false 探索を続ける
+	 */
+	inline bool isInterrupted(const size_t count) const
+	{
+		return isStopRequested() || (count % DeadlineCheckInterval == 0 && isOverDeadline());
+	}
 
-						next2->commands[turn] = CommandPack::Cast(convertCastActionId[CastSpell[castIndex].actionId], times);
+	/**
+	 * @brief 相手の探索スレッドの処理(依頼ごとに相手の探索を行い、終了要求まで待機する)
+	 *
+	 */
+	void surveyLoop()
+	{
+		unsigned int served = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(surveyMutex);
+				surveyWake.wait(lock, [&]() { return surveyQuit || surveyRequest != served; });
+				if (surveyQuit)
+					return;
+				served = surveyRequest;
+			}
 
-						nextQueue.push(next2);
+			surveyor->pool.clear();
+			surveyor->dominanceFilter.clear();
+			surveyor->thinkOpponent(&forecast);
+			Profiler::Publish();
 
-						times++;
-					}
-				}
+			{
+				std::lock_guard<std::mutex> lock(forecast.mutex);
+				forecast.done = true;
 			}
+			forecast.published.notify_all();
 		}
 	}
+
 	/**
-	 * @brief fޕϊ
+	 * @brief 相手の探索スレッドを終了させる
 	 *
-	 * @param castIndex Xyԍ
-	 * @param times XyJԉ
-	 * @param magic Xyt
-	 * @param turn T^[
-	 * @param top Tm[h
-	 * @param nextQueue ̒TL[
 	 */
-	inline void searchCast(const size_t castIndex, const int times, const MagicBit magic, const size_t turn, const DataPack top, PriorityQueue &nextQueue)
+	void endSurveyThread()
 	{
-		if (magic.getCastable())
+		if (!surveyThread.joinable())
+			return;
+
 		{
-			if (top->inventory.isAccept(CastSpell[castIndex].delta))
-			{
-				DataPack next = new (Pool::instance->get()) Data<SearchTurn>(*top);
+			std::lock_guard<std::mutex> lock(surveyMutex);
+			surveyQuit = true;
+		}
+		surveyWake.notify_one();
+		surveyThread.join();
+	}
 
-				next->magicList[castIndex].setCastCastable(false);
+	/**
+	 * @brief 別スレッドで相手の探索を開始し、最初の予測が公開されるまで待つ
+	 *
+	 */
+	void startSurvey()
+	{
+		surveyor->gameTurn = gameTurn;
+		surveyor->potionLimit = potionLimit;
+		surveyor->pruning = pruning;
+		surveyor->surveyMilliseconds = searchMilliseconds + SurveyMilliseconds;
+		surveyor->deadline = deadline;
 
-				forange(t, times)
-				{
-					next->inventory += CastSpell[castIndex].delta;
-				}
-				next->commands[turn] = CommandPack::Cast(convertCastActionId[CastSpell[castIndex].actionId], times);
+		surveyStop = false;
+		forecast.version = 0;
+		forecast.done = false;
+		forecastVersion = 0;
 
-				next->score = (this->*evaluate)(turn, next, Object::Operation::Cast, magic, castIndex);
+		{
+			std::lock_guard<std::mutex> lock(surveyMutex);
+			surveyRequest++;
+		}
+		surveyWake.notify_one();
 
-				nextQueue.push(next);
-			}
+		{
+			std::unique_lock<std::mutex> lock(forecast.mutex);
+			forecast.published.wait(lock, [&]() { return forecast.version.load() != 0 || forecast.done.load(); });
 		}
+		syncForecast();
 	}
+
 	/**
-	 * @brief xe
+	 * @brief 相手の探索の新しい予測を取り込む
 	 *
-	 * @param castIndex Xyԍ
-	 * @param magic Xyt
-	 * @param turn T^[
-	 * @param top Tm[h
-	 * @param nextQueue ̒TL[
 	 */
-	inline void searchRest(const size_t turn, const DataPack top, PriorityQueue &nextQueue)
+	void syncForecast()
 	{
-		DataPack next = new (Pool::instance->get()) Data<SearchTurn>(*top);
+		const auto version = forecast.version.load(std::memory_order_acquire);
+		if (version == forecastVersion)
+			return;
+
+		std::lock_guard<std::mutex> lock(forecast.mutex);
+		opponentBrewTurn = forecast.brewTurn;
+		opponentTurnScore = forecast.turnScore;
+		forecastVersion = forecast.version.load(std::memory_order_relaxed);
+	}
 
-		for (auto &magic : next->magicList)
+	/**
+	 * @brief 別スレッドの相手の探索を終了させ、最終の予測を取り込む
+	 *
+	 */
+	void stopSurvey()
+	{
+		surveyStop = true;
 		{
-			if (magic.getCastAvailable())
-				magic.setCastCastable(true);
+			std::unique_lock<std::mutex> lock(forecast.mutex);
+			forecast.published.wait(lock, [&]() { return forecast.done.load(); });
 		}
+		syncForecast();
+		trace.surveyNodes = surveyor->trace.surveyNodes;
+	}
 
-		next->commands[turn] = CommandPack::Rest();
+	/**
+	 * @brief 最善手順の末端のノードがある探査キューを取得する
+	 * 探索深さの最善ノードとゲーム終了ノードを比べ、どちらもなければ(探索を中断した場合)最も深いノードとする
+	 *
+	 * @param chokudaiSearch 探査キュー
+	 * @param horizon 探索深さ
+	 * @return PriorityQueue* 探査キュー(ノードがない場合はnullptr)
+	 */
+	static PriorityQueue *bestQueue(std::array<PriorityQueue, MaxSearchTurn + 1> &chokudaiSearch, const size_t horizon)
+	{
+		auto &lastQueue = chokudaiSearch[horizon];
+		auto &endQueue = chokudaiSearch.back();
+		if (!lastQueue.empty() || !endQueue.empty())
+			return (endQueue.empty() || (!lastQueue.empty() && lastQueue.top().score >= endQueue.top().score) ? &lastQueue : &endQueue);
 
-		next->score = (this->*evaluate)(turn, next, Object::Operation::Rest, MagicBit{}, 0);
+		for (size_t turn = horizon - 1; turn > 0; turn--)
+		{
+			if (!chokudaiSearch[turn].empty())
+				return &chokudaiSearch[turn];
+		}
 
-		nextQueue.push(next);
+		return nullptr;
 	}
 
 	/**
-	 * @brief O̍őPZbg
+	 * @brief 前回の最善手をセットする
 	 *
 	 * @param chokudaiSearch
 	 */
-	void setLastCommand(std::array<PriorityQueue, SearchTurn + 1> &chokudaiSearch)
+	void setLastCommand(std::array<PriorityQueue, MaxSearchTurn + 1> &chokudaiSearch)
 	{
-		forange(turn, SearchTurn - 1)
+		PROFILE_SCOPE(SetLastCommand);
+
+		forange(turn, horizonStart - 1)
 		{
 			if (chokudaiSearch[turn].empty())
 				break;
 
-			const auto top = chokudaiSearch[turn].top();
-			chokudaiSearch[turn].pop();
+			const auto top = pop(chokudaiSearch[turn]);
 
 			const auto [ope, id, times] = topData.commands[turn + 1].getParam();
 
@@ -1911,8 +3978,9 @@ private:
 			{
 			case Object::Operation::Brew:
 			{
-				const auto idx = id - BrewPostion[0].actionId;
-				searchBrew(idx, top->magicList[idx], turn, top, chokudaiSearch[turn + 1], chokudaiSearch[SearchTurn]);
+				const auto slot = top->market.brewSlot(id - BrewPostion[0].actionId);
+				if (slot < Object::BrewSize)
+					searchBrew(slot, turn, top, chokudaiSearch[turn + 1], chokudaiSearch[MaxSearchTurn]);
 			}
 			break;
 
@@ -1933,8 +4001,9 @@ private:
 
 			case Object::Operation::Learn:
 			{
-				const auto idx = id;
-				searchLearn(idx, top->magicList[idx], turn, top, chokudaiSearch[turn + 1]);
+				const auto slot = top->market.tomeSlot(id);
+				if (slot < Object::LearnSize)
+					searchLearn(slot, turn, top, chokudaiSearch[turn + 1]);
 			}
 			break;
 
@@ -1946,51 +4015,95 @@ private:
 				break;
 			}
 
-			Pool::instance->release(top);
+			unref(top);
 		}
 	}
 
-	void thinkOpponent()
+	/**
+	 * @brief 探索の初期ノードを作成する
+	 *
+	 * @param inventory 素材所持状態
+	 * @param casts 所持スペル
+	 * @param brewCount ポーション作成数
+	 * @return DataPack 初期ノード
+	 */
+	DataPack createRoot(const Inventory &inventory, const std::vector<Magic> &casts, const int brewCount)
 	{
-		const auto &share = Share::Get();
-		opponentTurnScore.fill(share.getOpponentInventory().score);
+		DataPack init = new (pool.get()) Data<MaxSearchTurn>();
+
+		init->inventory = inventory.inv;
 
-		std::array<PriorityQueue, SearchTurn + 1> chokudaiSearch;
+		init->magicList = convertInputData(casts);
+		init->castMask = 0;
+		forange(i, CastSpellSize)
 		{
-			DataPack init = new (Pool::instance->get()) Data<SearchTurn>();
+			if (init->magicList[i].getCastAvailable())
+				init->castMask |= (1ull << i);
+		}
+		init->market = convertMarket();
+
+		init->brewCount = brewCount;
+		init->price = inventory.score;
 
-			init->inventory = share.getOpponentInventory().inv;
+		const auto &brews = share.getBrews();
+		init->bonus3 = brews[0].taxCount;
+		init->bonus1 = brews[1].taxCount;
+
+		return init;
+	}
 
-			init->magicList = convertInputData(share.getOpponentCasts());
+	/**
+	 * @brief 相手の探索を行い、ポーションの作成ターンと各ターンの得点を予測する
+	 *
+	 * @param publish 1周ごとに予測を公開する先(nullptrの場合は公開しない)
+	 */
+	void thinkOpponent(OpponentForecast *publish = nullptr)
+	{
+		PROFILE_SCOPE(ThinkOpponent);
 
-			//IȂ
-			init->brewCount = 0;
-			init->price = share.getOpponentInventory().score;
+		opponentTurnScore.fill(share.getOpponentInventory().score);
 
-			const auto brews = share.getBrews();
-			init->bonus3 = brews[0].taxCount;
-			init->bonus1 = brews[1].taxCount;
+		std::array<PriorityQueue, MaxSearchTurn + 1> chokudaiSearch;
+		{
+			//終了判定をさせない
+			DataPack init = createRoot(share.getOpponentInventory(), share.getOpponentCasts(), 0);
 
 			evaluate = &AI::evaluateOpponent;
 
-			chokudaiSearch.front().push(init);
+			pushRoot(chokudaiSearch.front(), init);
 		}
 
 		opponentBrewTurn.fill(std::numeric_limits<int>::max());
 
-		MilliSecTimer timer(SurveyMilliseconds);
+		MilliSecTimer timer(surveyMilliseconds);
+		surveyWidth.reset(SurveyTurn);
+		size_t surveyCount = 0;
+		const auto finished = [&]() {
+			return (surveyNodeBudget > 0 ? surveyCount >= surveyNodeBudget : timer.check()) || isOverDeadline() || isStopRequested();
+		};
+
+		//1周で確保しうるノード数
+		const size_t loopMemory = SurveyTurn * surveyWidth.maxWidth() + 1;
+
 		timer.start();
-		while (!timer.check())
+		while (!finished() && pool.remain() > loopMemory)
 		{
+			const auto passCount = surveyCount;
 			forange(turn, SurveyTurn)
 			{
-				forange(w, ChokudaiWidth)
+				const auto before = chokudaiSearch[turn + 1].size();
+				const auto width = surveyWidth[turn];
+				forange_type(int, w, width)
 				{
 					if (chokudaiSearch[turn].empty())
 						break;
+					if (surveyNodeBudget > 0 && surveyCount >= surveyNodeBudget)
+						break;
+					if (isInterrupted(surveyCount))
+						break;
+					surveyCount++;
 
-					const auto top = chokudaiSearch[turn].top();
-					chokudaiSearch[turn].pop();
+					const auto top = pop(chokudaiSearch[turn]);
 
 					if (turn > 0 && top->commands[turn - 1].getOperation() == Object::Operation::Brew)
 					{
@@ -1999,60 +4112,347 @@ private:
 					}
 					else
 					{
-						forange(i, BrewPostionSize)
-						{
-							searchBrew(i, top->magicList[i], turn, top, chokudaiSearch[turn + 1], chokudaiSearch[SearchTurn]);
-						}
+						expand(turn, top, chokudaiSearch, true);
+					}
 
-						forange(i, LearnSpellSize)
-						{
-							searchLearn(i, top->magicList[i], turn, top, chokudaiSearch[turn + 1]);
-						}
+					unref(top);
+				}
+				surveyWidth.record(turn, chokudaiSearch[turn + 1].size() - before);
+			}
+			if (surveyNodeBudget > 0)
+				surveyWidth.update(surveyCount, surveyNodeBudget);
+			else
+				surveyWidth.update(timer.interval(), surveyMilliseconds.count());
 
-						forange(i, CastSpellSize)
-						{
-							searchCast(i, top->magicList[i], turn, top, chokudaiSearch[turn + 1]);
-						}
+			if (publish != nullptr)
+			{
+				updateOpponentTurnScore();
 
-						searchRest(turn, top, chokudaiSearch[turn + 1]);
-					}
+				std::lock_guard<std::mutex> lock(publish->mutex);
+				publish->brewTurn = opponentBrewTurn;
+				publish->turnScore = opponentTurnScore;
+				publish->version++;
+				publish->published.notify_all();
+			}
+
+			//探索し尽くした
+			if (surveyCount == passCount)
+				break;
+		}
+		trace.surveyNodes = surveyCount;
+
+		updateOpponentTurnScore();
+	}
+
+	/**
+	 * @brief ポーションの作成ターンの予測から相手の各ターンの得点を求める
+	 *
+	 */
+	void updateOpponentTurnScore()
+	{
+		opponentTurnScore.fill(share.getOpponentInventory().score);
+
+		forstep(turn, 1, MaxSearchTurn)
+		{
+			const auto max = std::max_element(opponentBrewTurn.cbegin(), opponentBrewTurn.cend(), [turn](const int a, const int b) {
+				return (a == static_cast<int>(turn) ? BrewPostion[a].price : 0) < (b == static_cast<int>(turn) ? BrewPostion[b].price : 0);
+			});
+			if ((*max) == std::numeric_limits<int>::max())
+			{
+				opponentTurnScore[turn] = opponentTurnScore[turn - 1];
+			}
+			else
+			{
+				opponentTurnScore[turn] = std::max(opponentTurnScore[turn - 1], opponentTurnScore[turn] + (*max));
+			}
+		}
+	}
+
+	/**
+	 * @brief 初期ノードの子ノードの評価値を記録する(同じ処理内容は最大値)
+	 *
+	 * @param queue 深さ1の探査キュー
+	 */
+	void traceRootMoves(PriorityQueue queue)
+	{
+		trace.rootMoves.clear();
+		while (!queue.empty())
+		{
+			const auto &child = queue.top();
+			const auto it = std::find_if(trace.rootMoves.cbegin(), trace.rootMoves.cend(), [&](const SearchTrace::RootMove &move) {
+				return move.command.getParam() == child.command.getParam();
+			});
+			//スコアの降順に取り出すため最初の値が最大
+			if (it == trace.rootMoves.cend())
+				trace.rootMoves.push_back(SearchTrace::RootMove{child.command, scoreToDouble(child.score)});
+			queue.pop();
+		}
+	}
+
+	/**
+	 * @brief 探索結果を記録する
+	 *
+	 */
+	void traceResult()
+	{
+		trace.poolCapacity = pool.capacity();
+		trace.poolPeak = pool.peak();
+		trace.poolLive = pool.capacity() - std::min(pool.capacity(), pool.remain());
+
+		trace.pv.clear();
+		for (const auto &command : topData.commands)
+		{
+			if (command.getOperation() == Object::Operation::Wait)
+				break;
+			trace.pv.push_back(command);
+		}
+		trace.score = scoreToDouble(topData.score);
+
+		forange(i, opponentBrewTurn.size())
+		{
+			if (opponentBrewTurn[i] != std::numeric_limits<int>::max())
+				trace.opponentBrewTurn.emplace_back(static_cast<int>(i + BrewPostion[0].actionId), opponentBrewTurn[i]);
+		}
+		trace.opponentTurnScore.assign(opponentTurnScore.cbegin(), opponentTurnScore.cend());
+	}
+
+public:
+	/**
+	 * @brief Construct a new AI object
+	 *
+	 * @param share 思考するゲームの状態
+	 */
+	AI(const Share &share) : AI(share, std::make_shared<SearchArena>(sizeof(Node) * DefaultNodeCount)) {}
+
+	/**
+	 * @brief Construct a new AI object
+	 *
+	 * @param share 思考するゲームの状態
+	 * @param arena 探索ノード用のメモリ領域(他のAIと共有可)
+	 */
+	AI(const Share &share, const std::shared_ptr<SearchArena> &arena) : share(share), pool(arena) {}
+
+	~AI()
+	{
+		endSurveyThread();
+	}
+
+	/**
+	 * @brief 自身の探索のビーム幅を設定する
+	 *
+	 * @param schedule ビーム幅
+	 */
+	void setSearchWidth(const WidthSchedule &schedule)
+	{
+		searchWidth = schedule;
+	}
+	/**
+	 * @brief 相手の探索のビーム幅を設定する
+	 *
+	 * @param schedule ビーム幅
+	 */
+	void setSurveyWidth(const WidthSchedule &schedule)
+	{
+		surveyWidth = schedule;
+		if (surveyor)
+			surveyor->surveyWidth = schedule;
+	}
+
+	/**
+	 * @brief 探索を展開ノード数で打ち切るよう設定する(制限時間は無視する)
+	 *
+	 * @param search 自身の探索の展開ノード数(0:制限時間で打ち切る)
+	 * @param survey 相手の探索の展開ノード数(0:制限時間で打ち切る)
+	 */
+	void setNodeBudget(const size_t search, const size_t survey)
+	{
+		searchNodeBudget = search;
+		surveyNodeBudget = survey;
+	}
+
+	/**
+	 * @brief 行動生成時の枝刈りを設定する
+	 *
+	 * @param rules 枝刈りの規則
+	 */
+	void setPruning(const Pruning &rules)
+	{
+		pruning = rules;
+	}
+
+	/**
+	 * @brief 探索深さを設定する
+	 *
+	 * @param start 探索開始時の深さ
+	 * @param max 探索中に伸ばせる深さの上限(MaxSearchTurnまで)
+	 */
+	void setHorizon(const size_t start, const size_t max)
+	{
+		horizonStart = std::clamp<size_t>(start, 1, MaxSearchTurn);
+		horizonMax = std::clamp<size_t>(max, horizonStart, MaxSearchTurn);
+	}
+
+	/**
+	 * @brief 探索の記録を行うか設定する
+	 *
+	 * @param use 記録する場合はtrue
+	 */
+	void setTrace(const bool use)
+	{
+		tracing = use;
+	}
+
+	/**
+	 * @brief 直前の探索の記録を取得する(setTraceで有効にした場合のみ)
+	 *
+	 * @return const SearchTrace& 探索の記録
+	 */
+	const SearchTrace &getTrace() const
+	{
+		return trace;
+	}
+
+	/**
+	 * @brief 自身の探索の制限時間を設定する
+	 *
+	 * @param limit 制限時間
+	 */
+	void setTimeLimit(const std::chrono::milliseconds limit)
+	{
+		searchMilliseconds = limit;
+	}
+
+	/**
+	 * @brief 相手の探索と自身の探索を合わせた1ターンの制限時間を設定する
+	 * 自身の探索には相手の探索の時間を除いた残りを使う
+	 *
+	 * @param limit 制限時間
+	 */
+	void setTurnTimeLimit(const std::chrono::milliseconds limit)
+	{
+		searchMilliseconds = std::max(std::chrono::milliseconds{1}, limit - surveyMilliseconds);
+	}
+
+	/**
+	 * @brief ターンの協調的な応答期限を設定する
+	 * 相手の探索・自身の探索とも、一定間隔で期限を確認し、過ぎていたらその時点の最善手で打ち切る
+	 * (確認の間隔より長く止まった場合に代わりの手を出力するものではない)
+	 *
+	 * @param time 期限の時刻(time_point::max()で無効)
+	 */
+	void setDeadline(const std::chrono::high_resolution_clock::time_point time)
+	{
+		deadline = time;
+	}
+
+	/**
+	 * @brief 探索の中断要求を受け取るフラグを設定する
+	 * 別スレッドからtrueにすると、展開中のノードの処理後にその時点の最善手で打ち切る
+	 *
+	 * @param flag フラグ(nullptrで無効、探索中は有効なこと)
+	 */
+	void setStopFlag(const std::atomic<bool> *flag)
+	{
+		stopFlag = flag;
+	}
+
+	/**
+	 * @brief 探索の中断が要求されたかを得る
+	 *
+	 * @return true 中断が要求された
+	 * @return false 要求されていない、またはフラグなし
+	 */
+	bool isStopRequested() const
+	{
+		return stopFlag != nullptr && stopFlag->load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief 相手の探索を別スレッドで自身の探索と並行して行うか設定する
+	 * 並行する場合は相手の探索時間も自身の探索に使い、相手の探索は自身の探索が終わるまで続ける
+	 * (予測は自身の探索の1周ごとに取り込むため、展開ノード数で打ち切る場合も結果は再現しない)
+	 *
+	 * @param concurrent true:並行する、false:自身の探索の前に行う
+	 */
+	void setConcurrentSurvey(const bool concurrent)
+	{
+		if (concurrent && !surveyor)
+		{
+			surveyor = std::make_unique<AI>(share, std::make_shared<SearchArena>(sizeof(Node) * SurveyNodeCount));
+			surveyor->setStopFlag(&surveyStop);
+			//ビーム幅は相手の探索スレッド側で調整し、ターンをまたいで引き継ぐ
+			surveyor->surveyWidth = surveyWidth;
+
+			surveyQuit = false;
+			surveyThread = std::thread([this]() { surveyLoop(); });
+		}
+		else if (!concurrent)
+		{
+			endSurveyThread();
+			surveyor.reset();
+		}
+	}
+
+	/**
+	 * @brief 応答期限を過ぎたかを得る
+	 *
+	 * @return true 期限を過ぎた
+	 * @return false 期限内、または期限なし
+	 */
+	bool isOverDeadline() const
+	{
+		return deadline != std::chrono::high_resolution_clock::time_point::max() && std::chrono::high_resolution_clock::now() >= deadline;
+	}
+
+	/**
+	 * @brief 乱数のシードを設定する
+	 *
+	 * @param seed シード
+	 */
+	void setSeed(const uint64_t seed)
+	{
+		xoshiro = XoShiro128(seed);
+	}
 
-					Pool::instance->release(top);
-				}
-			}
-		}
+	/**
+	 * @brief 直前の探索で展開したノード数を取得する
+	 *
+	 * @return size_t 展開ノード数
+	 */
+	size_t getExpandCount() const
+	{
+		return expandCount;
+	}
 
-		forstep(turn, 1, SearchTurn)
-		{
-			const auto max = std::max_element(opponentBrewTurn.cbegin(), opponentBrewTurn.cend(), [turn](const int a, const int b) {
-				return (a == turn ? BrewPostion[a].price : 0) < (b == turn ? BrewPostion[b].price : 0);
-			});
-			if ((*max) == std::numeric_limits<int>::max())
-			{
-				opponentTurnScore[turn] = opponentTurnScore[turn - 1];
-			}
-			else
-			{
-				opponentTurnScore[turn] = std::max(opponentTurnScore[turn - 1], opponentTurnScore[turn] + (*max));
-			}
-		}
+	/**
+	 * @brief 直前の探索のノードの最大確保数を取得する(相手の探索を除く)
+	 *
+	 * @return size_t 確保数
+	 */
+	size_t getPoolPeak() const
+	{
+		return pool.peak();
 	}
 
-public:
-	AI()
+	/**
+	 * @brief ノードの確保可能数を取得する
+	 *
+	 * @return size_t 確保可能数
+	 */
+	size_t getPoolCapacity() const
 	{
-		Pool::Create();
+		return pool.capacity();
 	}
 
-	template <int S, int T, int M>
-	void setTopData(const AI<S, T, M> &ai)
+	template <int S, int T, int M, bool B>
+	void setTopData(const AI<S, T, M, B> &ai)
 	{
-		static_assert(S >= SearchTurn);
+		static_assert(M >= MaxSearchTurn);
 
-		errerLine(std::to_string(ai.topData.score));
+		errerLine(std::to_string(scoreToDouble(ai.topData.score)));
 		std::fill(strongCastSet, strongCastSet + CastSpellSize, false);
 
-		forange(i, SearchTurn)
+		forange(i, MaxSearchTurn)
 		{
 			const auto &topCom = ai.topData.commands[i];
 			topData.commands[i] = topCom;
@@ -2066,31 +4466,44 @@ public:
 
 	std::string think()
 	{
-		Pool::instance->clear();
+		PROFILE_SCOPE(Think);
+
+		pool.clear();
+		expandCount = 0;
 
-		const auto &share = Share::Get();
 		gameTurn = share.getTurn();
+		if (tracing)
+		{
+			trace = SearchTrace{};
+			trace.turn = gameTurn;
+		}
 		opponentInventoryScore = share.getOpponentInventory().inv.getScore();
 
+		if (surveyor)
+		{
+			opponentBrewTurn.fill(std::numeric_limits<int>::max());
+			opponentTurnScore.fill(share.getOpponentInventory().score);
+			dominanceFilter.clear();
+			startSurvey();
+		}
+		else
 		{
+			Stopwatch sw;
+			sw.start();
+			dominanceFilter.clear();
 			thinkOpponent();
-			Pool::instance->clear();
+			pool.clear();
+			dominanceFilter.clear();
+			sw.stop();
+			trace.surveyMicroseconds = sw.microseconds();
 		}
+		Stopwatch searchTime;
+		searchTime.start();
 
-		std::array<PriorityQueue, SearchTurn + 1> chokudaiSearch;
+		std::array<PriorityQueue, MaxSearchTurn + 1> chokudaiSearch;
 		{
-			DataPack init = new (Pool::instance->get()) Data<SearchTurn>();
-
-			init->inventory = share.getInventory().inv;
-
-			init->magicList = convertInputData(share.getCasts());
-
-			init->brewCount = share.getBrewCount();
-			init->price = share.getInventory().score;
-
-			const auto brews = share.getBrews();
-			init->bonus3 = brews[0].taxCount;
-			init->bonus1 = brews[1].taxCount;
+			DataPack init = createRoot(share.getInventory(), share.getCasts(), share.getBrewCount());
+			inventoryDistance.build(share.getCasts(), share.getBrews());
 
 			if (gameTurn == 0)
 			{
@@ -2105,77 +4518,149 @@ public:
 
 			if (share.getOpponentOperation() == Object::Operation::Cast)
 			{
-				DataPack init2 = new (Pool::instance->get()) Data<SearchTurn>(*init);
+				DataPack init2 = new (pool.get()) Data<MaxSearchTurn>(*init);
 
-				chokudaiSearch.front().push(init);
+				pushRoot(chokudaiSearch.front(), init);
 				setLastCommand(chokudaiSearch);
-				chokudaiSearch.front().push(init2);
+				pushRoot(chokudaiSearch.front(), init2);
 			}
 			else
 			{
-				chokudaiSearch.front().push(init);
+				pushRoot(chokudaiSearch.front(), init);
 			}
 		}
 
-		MilliSecTimer timer(SearchMilliseconds);
+		//相手の探索を並行する場合は、その時間も自身の探索に使う
+		const auto timeLimit = (surveyor ? searchMilliseconds + SurveyMilliseconds : searchMilliseconds);
+		MilliSecTimer timer(timeLimit);
 
 		int loopCount = 0;
 		int learnTurnLimit = std::max(3, 10 - gameTurn);
 
+		searchWidth.reset(MaxSearchTurn);
+
+		//1周で確保しうるノード数(子ノードは取り出した時のみ確保する)
+		const size_t loopMemory = horizonMax * searchWidth.maxWidth() + 1;
+
+		const auto finished = [&]() {
+			return (searchNodeBudget > 0 ? expandCount >= searchNodeBudget : timer.check()) || isOverDeadline() || isStopRequested();
+		};
+
+		if (tracing)
+			trace.depthNodes.assign(MaxSearchTurn, 0);
+
+		size_t horizon = horizonStart;
+		Score horizonBest = std::numeric_limits<Score>::min();
+		int stallCount = 0;
+
 		timer.start();
-		while (!timer.check())
+		//中断されても手を返せるよう、初期ノードは必ず展開する
+		while ((expandCount == 0 || !finished()) && pool.remain() > loopMemory)
 		{
 			loopCount++;
-			forange(turn, SearchTurn)
+			const auto passCount = expandCount;
+			if (surveyor)
+				syncForecast();
+
+			forange(turn, horizon)
 			{
-				forange(w, ChokudaiWidth)
+				const auto before = chokudaiSearch[turn + 1].size();
+				const auto width = searchWidth[turn];
+				forange_type(int, w, width)
 				{
 					if (chokudaiSearch[turn].empty())
 						break;
+					if (searchNodeBudget > 0 && expandCount >= searchNodeBudget)
+						break;
+					if (expandCount > 0 && isInterrupted(expandCount))
+						break;
+					expandCount++;
 
-					const auto top = chokudaiSearch[turn].top();
-					chokudaiSearch[turn].pop();
+					const auto top = pop(chokudaiSearch[turn]);
 
-					forange(i, BrewPostionSize)
-					{
-						searchBrew(i, top->magicList[i], turn, top, chokudaiSearch[turn + 1], chokudaiSearch[SearchTurn]);
-					}
+					expand(turn, top, chokudaiSearch, static_cast<int>(turn) < learnTurnLimit);
 
-					if (turn < learnTurnLimit)
-					{
-						forange(i, LearnSpellSize)
-						{
-							searchLearn(i, top->magicList[i], turn, top, chokudaiSearch[turn + 1]);
-						}
-					}
+					unref(top);
 
-					forange(i, CastSpellSize)
-					{
-						searchCast(i, top->magicList[i], turn, top, chokudaiSearch[turn + 1]);
-					}
+					if (tracing)
+						trace.depthNodes[turn]++;
+				}
+				searchWidth.record(turn, chokudaiSearch[turn + 1].size() - before);
+
+				if (tracing && turn == 0 && chokudaiSearch[1].size() != before)
+					traceRootMoves(chokudaiSearch[1]);
+			}
+			if (searchNodeBudget > 0)
+				searchWidth.update(expandCount, searchNodeBudget);
+			else
+				searchWidth.update(timer.interval(), timeLimit.count());
+
+			//探索し尽くした
+			if (expandCount == passCount)
+				break;
 
-					searchRest(turn, top, chokudaiSearch[turn + 1]);
+			//最善の評価値が頭打ちで、残りの予算で伸ばした深さを数周できるなら深さを伸ばす
+			if (horizon < horizonMax && !chokudaiSearch[horizon].empty())
+			{
+				const auto best = chokudaiSearch[horizon].top().score;
+				if (best > horizonBest)
+				{
+					horizonBest = best;
+					stallCount = 0;
+				}
+				else if (++stallCount >= StallLoops)
+				{
+					const double used = (searchNodeBudget > 0 ? static_cast<double>(expandCount) : static_cast<double>(timer.interval()));
+					const double limit = (searchNodeBudget > 0 ? static_cast<double>(searchNodeBudget) : static_cast<double>(timeLimit.count()));
+					const double remainLoops = (used > 0 ? (limit - used) * loopCount / used : 0);
 
-					Pool::instance->release(top);
+					if (remainLoops >= StallLoops)
+					{
+						horizon++;
+						horizonBest = std::numeric_limits<Score>::min();
+						stallCount = 0;
+					}
 				}
 			}
 		}
 
-		if (chokudaiSearch.back().empty())
+		searchTime.stop();
+		trace.horizon = static_cast<int>(horizon);
+		if (surveyor)
+		{
+			stopSurvey();
+			trace.surveyMicroseconds = searchTime.microseconds();
+		}
+
+		const auto resultQueue = bestQueue(chokudaiSearch, horizon);
+		trace.searchMicroseconds = searchTime.microseconds();
+
+		if (resultQueue == nullptr)
 		{
-			errerLine("zÕG[");
+			errerLine("想定外のエラー");
+			if (tracing)
+			{
+				traceResult();
+				trace.pv.assign(1, CommandPack::Rest());
+				trace.score = 0;
+			}
 			return CommandRest();
 		}
 		else
 		{
-			topData = *chokudaiSearch.back().top();
+			const auto &best = resultQueue->top();
+			topData = *best.parent;
+			apply(best, topData);
 			const auto com = topData.commands[0].getCommand();
 
+			if (tracing)
+				traceResult();
+
 			std::string debugMes = "";
 
 			int setTurn = 0;
 			bool add = false;
-			forange(i, SearchTurn)
+			forange(i, horizon)
 			{
 				if (topData.commands[i].getOperation() == Object::Operation::Brew)
 				{
@@ -2206,49 +4691,488 @@ public:
 	}
 };
 
-#pragma endregion
+/**
+ * @brief 1ゲーム分の思考エンジン
+ * ゲームの状態と探索用のメモリを所有するため、複数のゲームを別スレッドで並行して動かせる
+ *
+ */
+class Engine
+{
+public:
+	using FirstAI = AI<35, 990>;
+	using TurnAI = AI<22, 45, 30>;
 
-#pragma region f[^o
+	struct Option
+	{
+		//1ターン目とそれ以降で使うメモリ量(MB)
+		size_t firstArenaMB = sizeof(FirstAI::Node) * (1 << 21) / (1024 * 1024);
+		size_t arenaMB = sizeof(TurnAI::Node) * TurnAI::DefaultNodeCount / (1024 * 1024);
+		SearchArena::Backing backing = SearchArena::Backing::Malloc;
+
+		WidthSchedule firstWidth{FirstAI::ChokudaiWidth};
+		WidthSchedule width{TurnAI::ChokudaiWidth};
+		WidthSchedule surveyWidth{TurnAI::ChokudaiWidth};
+		size_t firstNodes = 0;
+		size_t nodes = 0;
+		size_t surveyNodes = 0;
+		//2ターン目以降の探索深さ(探索開始時と上限)
+		size_t horizon = TurnAI::DefaultHorizon;
+		size_t maxHorizon = TurnAI::MaxHorizon;
+		Pruning pruning;
+		bool useSeed = false;
+		uint64_t seed = 0;
+
+		//ターンごとの探索の記録の出力先(空の場合は出力しない)
+		std::string tracePath;
+
+		//最初の行を受け取ってから出力までの制限時間(ミリ秒、0:期限を設けずAIの既定の制限時間で探索する)
+		long long firstTurnMilliseconds = 1000;
+		long long turnMilliseconds = 50;
+		//応答期限を制限時間のこの時間前にする(出力の時間)
+		//探索の制限時間と応答期限はどちらも制限時間からこの時間を引いたものにする
+		long long marginMilliseconds = 3;
+
+		//2ターン目以降、相手の探索を別スレッドで並行する(展開ノード数で打ち切る場合は行わない)
+		//1コアの環境では自身の探索が遅くなるため、既定では行わない(--survey-thread 1で有効にする)
+		bool surveyThread = false;
+	};
 
-int main()
-{
+	/**
+	 * @brief ターンの処理の区間(制限時間を超えた原因)
+	 *
+	 */
+	enum class Phase : int
+	{
+		Parse,
+		Think,
+		Output,
+		Size
+	};
+
+private:
+	const Option option;
+
+	Share share;
+
+	//2つのAIは同時に探索しないため1つの領域を共有する
+	std::shared_ptr<SearchArena> arena;
+	FirstAI aiFirst;
+	TurnAI ai;
+
+	bool first = true;
+	//次の入力の前に探索用のメモリを縮める
+	bool shrinkArena = false;
+	size_t expandCount = 0;
+	//直前の思考のノードの最大確保数と確保可能数
+	size_t poolPeak = 0;
+	size_t poolCapacity = 0;
+
+	std::unique_ptr<std::ofstream> trace;
+	long long parseMicroseconds = 0;
+	std::chrono::high_resolution_clock::time_point arrival;
+
+	//探索の中断要求(ターンの思考開始時に解除する)
+	std::atomic<bool> stop{false};
+
+	int turn = 0;
+	//制限時間を超えたターン数(原因の区間ごと)
+	std::array<int, static_cast<size_t>(Phase::Size)> lateTurns{};
+
+public:
+	/**
+	 * @brief Construct a new Engine object
+	 * 探索用のメモリは最初の入力を読む前に確保する(HugePageの場合はページの割り当ても済ませる)
+	 *
+	 * @param option 設定
+	 */
+	Engine(const Option &option)
+		: option(option),
+		  arena(std::make_shared<SearchArena>(option.firstArenaMB * 1024 * 1024, option.backing)),
+		  aiFirst(share, arena),
+		  ai(share, arena)
+	{
+		aiFirst.setSearchWidth(option.firstWidth);
+		ai.setSearchWidth(option.width);
+		ai.setSurveyWidth(option.surveyWidth);
+		aiFirst.setNodeBudget(option.firstNodes, option.surveyNodes);
+		ai.setNodeBudget(option.nodes, option.surveyNodes);
+		ai.setHorizon(option.horizon, option.maxHorizon);
+		aiFirst.setPruning(option.pruning);
+		ai.setPruning(option.pruning);
+		if (option.useSeed)
+		{
+			aiFirst.setSeed(option.seed);
+			ai.setSeed(option.seed);
+		}
+		if (!option.tracePath.empty())
+		{
+			trace = std::make_unique<std::ofstream>(option.tracePath);
+			aiFirst.setTrace(true);
+			ai.setTrace(true);
+		}
+		if (option.firstTurnMilliseconds > 0)
+			aiFirst.setTurnTimeLimit(std::chrono::milliseconds(responseMilliseconds(option.firstTurnMilliseconds)));
+		if (option.turnMilliseconds > 0)
+			ai.setTurnTimeLimit(std::chrono::milliseconds(responseMilliseconds(option.turnMilliseconds)));
+		aiFirst.setStopFlag(&stop);
+		ai.setStopFlag(&stop);
+		ai.setConcurrentSurvey(option.surveyThread && option.nodes == 0 && option.surveyNodes == 0);
+	}
+
+	Engine() : Engine(Option{}) {}
+
+	Engine(const Engine &) = delete;
+	Engine &operator=(const Engine &) = delete;
+
+private:
+	/**
+	 * @brief 探索の記録を1行出力する
+	 *
+	 * @param searchTrace 探索の記録
+	 */
+	void writeTrace(const SearchTrace &searchTrace)
+	{
+		if (!trace)
+			return;
+
+		auto line = searchTrace;
+		line.parseMicroseconds = parseMicroseconds;
+		(*trace) << line.toJson() << std::endl;
+	}
+
+	/**
+	 * @brief 最初の行を受け取ってからの経過時間を取得する(マイクロ秒)
+	 *
+	 */
+	long long elapsed() const
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - arrival).count();
+	}
+
+	/**
+	 * @brief 現在のターンの制限時間を取得する(ミリ秒、0:期限なし)
+	 *
+	 */
+	long long turnLimit() const
+	{
+		return first ? option.firstTurnMilliseconds : option.turnMilliseconds;
+	}
+
+	/**
+	 * @brief 制限時間から出力の時間を除いた、応答までに使える時間を取得する(ミリ秒)
+	 *
+	 * @param limit 制限時間(ミリ秒)
+	 */
+	long long responseMilliseconds(const long long limit) const
+	{
+		return std::max(0ll, limit - option.marginMilliseconds);
+	}
+
+	/**
+	 * @brief AIに現在のターンの協調的な応答期限を設定する
+	 * 展開ノード数で打ち切る場合は結果を再現させるため設定しない
+	 *
+	 * @param target AI
+	 * @param nodes 展開ノード数の上限
+	 */
+	template <class AIType>
+	void setDeadline(AIType &target, const size_t nodes) const
+	{
+		const auto limit = turnLimit();
+		if (limit > 0 && nodes == 0)
+			target.setDeadline(arrival + std::chrono::milliseconds(responseMilliseconds(limit)));
+		else
+			target.setDeadline(std::chrono::high_resolution_clock::time_point::max());
+	}
+
+	/**
+	 * @brief 制限時間を超えたターンを記録する
+	 * 原因は累計時間が制限時間を超えた区間とする
+	 *
+	 * @param limit 制限時間(ミリ秒)
+	 * @param phaseEnd 各区間の終了時の経過時間(マイクロ秒)
+	 */
+	void recordLatency(const long long limit, const std::array<long long, static_cast<size_t>(Phase::Size)> &phaseEnd)
+	{
+		static const char *const names[] = {"parse", "think", "output"};
+
+		if (limit <= 0)
+			return;
+
+		forange(i, phaseEnd.size())
+		{
+			if (phaseEnd[i] > limit * 1000)
+			{
+				lateTurns[i]++;
+				errerLine("late turn " + std::to_string(turn) + " " + std::to_string(phaseEnd.back() / 1000) + "ms cause " + names[i]);
+				return;
+			}
+		}
+	}
+
+public:
+
+	/**
+	 * @brief 1ターン分の入力を読み込む
+	 *
+	 * @param stream 入力
+	 * @return true 読み込んだ
+	 * @return false 入力の終端
+	 */
+	bool read(std::istream &stream)
+	{
+		if (shrinkArena)
+		{
+			arena->reserve(option.arenaMB * 1024 * 1024);
+			shrinkArena = false;
+		}
+
+		Input input(share, stream);
+		const auto result = input.loop();
+		parseMicroseconds = input.getParseTime().microseconds();
+		arrival = input.getArrival();
+
+		return result;
+	}
+
+	/**
+	 * @brief 読み込んだ状態から思考する
+	 *
+	 * @return std::string コマンド
+	 */
+	std::string think()
+	{
+		std::string com;
+		if (first)
+		{
+			setDeadline(aiFirst, option.firstNodes);
+			first = false;
+
+			com = aiFirst.think();
+			expandCount = aiFirst.getExpandCount();
+			poolPeak = aiFirst.getPoolPeak();
+			poolCapacity = aiFirst.getPoolCapacity();
+			writeTrace(aiFirst.getTrace());
+
+			ai.setTopData<>(aiFirst);
+
+			//1ターン目の探索が終わったので以降のターンに必要な量まで縮める(応答を遅らせないよう次の入力の前に行う)
+			shrinkArena = true;
+		}
+		else
+		{
+			setDeadline(ai, option.nodes);
+			com = ai.think();
+			expandCount = ai.getExpandCount();
+			poolPeak = ai.getPoolPeak();
+			poolCapacity = ai.getPoolCapacity();
+			writeTrace(ai.getTrace());
+		}
+
+		//中断の要求はこのターンで消費した(思考の開始前の要求は消さない)
+		stop.store(false);
+
+		return com;
+	}
+
+	/**
+	 * @brief 入力が終わるまで読み込みと思考を繰り返す
+	 *
+	 * @param in 入力
+	 * @param out コマンドの出力先
+	 */
+	void run(std::istream &in, std::ostream &out)
+	{
+		Stopwatch sw;
 
-	Share::Create();
+		while (read(in))
+		{
+			turn++;
+			const auto limit = turnLimit();
+			std::array<long long, static_cast<size_t>(Phase::Size)> phaseEnd{};
+			phaseEnd[static_cast<size_t>(Phase::Parse)] = elapsed();
+
+			sw.start();
+			const auto coms = think();
+			sw.stop();
+			phaseEnd[static_cast<size_t>(Phase::Think)] = elapsed();
+
+			errerLine(sw.toString_ms() + " " + std::to_string(expandCount) + "nodes");
+
+			{
+				PROFILE_SCOPE(Output);
+				//最初の行を受け取ってから出力までの時間
+				out << coms << " " << std::to_string(elapsed() / 1000) << "ms" << std::endl;
+			}
+			phaseEnd[static_cast<size_t>(Phase::Output)] = elapsed();
 
-	Input input;
-	input.first();
+			recordLatency(limit, phaseEnd);
+			Profiler::EndTurn();
+		}
 
-	Stopwatch sw;
+		if (turnLimit() > 0)
+		{
+			errerLine("late " + std::to_string(getLateTurns()) + "/" + std::to_string(turn) + " turns" +
+					  " parse:" + std::to_string(lateTurns[static_cast<size_t>(Phase::Parse)]) +
+					  " think:" + std::to_string(lateTurns[static_cast<size_t>(Phase::Think)]) +
+					  " output:" + std::to_string(lateTurns[static_cast<size_t>(Phase::Output)]));
+		}
+	}
 
-	AI<35, 990, 21> aiFirst;
-	AI<> ai;
+	/**
+	 * @brief ゲームの状態を取得する
+	 *
+	 * @return const Share& ゲームの状態
+	 */
+	const Share &getShare() const
+	{
+		return share;
+	}
 
+	/**
+	 * @brief 直前の思考で展開したノード数を取得する
+	 *
+	 * @return size_t 展開ノード数
+	 */
+	size_t getExpandCount() const
 	{
-		input.loop();
+		return expandCount;
+	}
 
-		sw.start();
-		const auto &coms = aiFirst.think();
-		sw.stop();
+	/**
+	 * @brief 直前の思考のノードの最大確保数を取得する
+	 *
+	 * @return size_t 確保数
+	 */
+	size_t getPoolPeak() const
+	{
+		return poolPeak;
+	}
 
-		ai.setTopData<>(aiFirst);
+	/**
+	 * @brief 直前の思考のノードの確保可能数を取得する
+	 *
+	 * @return size_t 確保可能数
+	 */
+	size_t getPoolCapacity() const
+	{
+		return poolCapacity;
+	}
 
-		errerLine(sw.toString_ms());
+	/**
+	 * @brief 直前に読み込んだターンの最初の行を受け取った時刻を取得する
+	 *
+	 * @return std::chrono::high_resolution_clock::time_point 時刻
+	 */
+	std::chrono::high_resolution_clock::time_point getArrival() const
+	{
+		return arrival;
+	}
 
-		std::cout << coms << " " << sw.toString_ms() << std::endl;
+	/**
+	 * @brief 思考中の探索を中断させる(別スレッドから呼び出せる)
+	 * 思考はその時点の最善手を返す(思考中でなければ次の思考を初期ノードの展開だけで終える)
+	 *
+	 */
+	void requestStop()
+	{
+		stop.store(true);
 	}
 
-	while (input.loop())
+	/**
+	 * @brief 制限時間を超えたターン数を取得する
+	 *
+	 * @return int ターン数
+	 */
+	int getLateTurns() const
 	{
-		sw.start();
-		const auto &coms = ai.think();
-		sw.stop();
+		int count = 0;
+		for (const auto late : lateTurns)
+			count += late;
+		return count;
+	}
+};
+
+#pragma endregion
+
+#pragma region データ出力
+
+#ifndef NO_MAIN
+
+int main(int argc, char *argv[])
+{
+	Engine::Option option;
+
+	//数値の引数(読み込めない場合は既定値のまま)
+	const auto readNumber = [](const std::string &text, auto &target) {
+		unsigned long long value = 0;
+		if (!parseNumber(text, value))
+		{
+			errerLine("数値ではない引数を無視します:" + text);
+			return false;
+		}
+		target = static_cast<std::remove_reference_t<decltype(target)>>(value);
+		return true;
+	};
 
-		errerLine(sw.toString_ms());
+	forstep_type(int, i, 1, argc)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--hugepage")
+		{
+			option.backing = SearchArena::Backing::HugePage;
+			continue;
+		}
+		if (i + 1 >= argc)
+			break;
 
-		std::cout << coms << " " << sw.toString_ms() << std::endl;
+		if (arg == "--profile")
+			Profiler::Open(argv[++i]);
+		else if (arg == "--first-arena-mb")
+			readNumber(argv[++i], option.firstArenaMB);
+		else if (arg == "--arena-mb")
+			readNumber(argv[++i], option.arenaMB);
+		else if (arg == "--first-width")
+			WidthSchedule::Parse(argv[++i], option.firstWidth);
+		else if (arg == "--width")
+			WidthSchedule::Parse(argv[++i], option.width);
+		else if (arg == "--survey-width")
+			WidthSchedule::Parse(argv[++i], option.surveyWidth);
+		else if (arg == "--first-nodes")
+			readNumber(argv[++i], option.firstNodes);
+		else if (arg == "--nodes")
+			readNumber(argv[++i], option.nodes);
+		else if (arg == "--survey-nodes")
+			readNumber(argv[++i], option.surveyNodes);
+		else if (arg == "--seed")
+		{
+			if (readNumber(argv[++i], option.seed))
+				option.useSeed = true;
+		}
+		else if (arg == "--horizon")
+			readNumber(argv[++i], option.horizon);
+		else if (arg == "--max-horizon")
+			readNumber(argv[++i], option.maxHorizon);
+		else if (arg == "--prune")
+			option.pruning = Pruning::Parse(argv[++i]);
+		else if (arg == "--trace")
+			option.tracePath = argv[++i];
+		else if (arg == "--first-turn-ms")
+			readNumber(argv[++i], option.firstTurnMilliseconds);
+		else if (arg == "--turn-ms")
+			readNumber(argv[++i], option.turnMilliseconds);
+		else if (arg == "--survey-thread")
+			readNumber(argv[++i], option.surveyThread);
 	}
 
+	Engine engine(option);
+	engine.run(std::cin, std::cout);
+
+	Profiler::EndGame();
+
 	return 0;
 }
 
+#endif // !NO_MAIN
+
 #pragma endregion
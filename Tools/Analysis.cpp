@@ -0,0 +1,173 @@
+/**
+ * @brief 局面解析ライブラリ(Analysis.hのC APIの実装)
+ *
+ * cmake -S . -B build && cmake --build build --target Analysis
+ *
+ * 局面ごとにゲームの状態とAIを作り直すため、同じ局面と予算(ノード数とシード)なら結果は再現する
+ */
+
+#define NO_MAIN
+#include "../FallChallenge2020/main.cpp"
+
+#include "Analysis.h"
+
+#include <atomic>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+	using FirstAI = Engine::FirstAI;
+	using TurnAI = Engine::TurnAI;
+
+	//スレッドごとの探索用メモリの既定値(以降のターンの探索に必要な量)
+	constexpr size_t DefaultArenaMB = sizeof(TurnAI::Node) * TurnAI::DefaultNodeCount / (1024 * 1024);
+
+	void copyString(char *dst, const size_t size, const std::string &src)
+	{
+		std::snprintf(dst, size, "%s", src.c_str());
+	}
+
+	template <class AIType>
+	int search(AIType &ai, const FcRequest &request, FcResult &result)
+	{
+		//相手の探索は自身の1/10のノード数で打ち切る
+		const auto nodes = static_cast<size_t>(request.nodes);
+		ai.setNodeBudget(nodes, nodes > 0 ? std::max<size_t>(1, nodes / 10) : 0);
+		if (request.milliseconds > 0)
+			ai.setTimeLimit(std::chrono::milliseconds(request.milliseconds));
+		if (request.seed != 0)
+			ai.setSeed(request.seed);
+
+		Stopwatch sw;
+		sw.start();
+		ai.think();
+		sw.stop();
+
+		result.nodes = ai.getExpandCount();
+		result.milliseconds = sw.microseconds() / 1000.0;
+
+		const auto &commands = ai.topData.commands;
+		if (commands[0].getOperation() == Object::Operation::Wait)
+			return FC_NO_MOVE;
+
+		std::string pv;
+		for (const auto &command : commands)
+		{
+			if (command.getOperation() == Object::Operation::Wait)
+				break;
+			pv += command.getCommand() + ";";
+		}
+		if (!pv.empty())
+			pv.pop_back();
+
+		copyString(result.command, sizeof(result.command), commands[0].getCommand());
+		copyString(result.pv, sizeof(result.pv), pv);
+		result.score = scoreToDouble(ai.topData.score);
+
+		return FC_OK;
+	}
+
+	int analyze(const std::shared_ptr<SearchArena> &arena, const FcRequest &request, FcResult &result)
+	{
+		if (request.state == nullptr)
+			return FC_INVALID_STATE;
+
+		Share share;
+		{
+			std::istringstream iss(request.state);
+			Input input(share, iss);
+			if (!input.loop())
+				return FC_INVALID_STATE;
+		}
+		//ボーナスの参照に先頭2つのポーション生成レシピを使う
+		if (share.getBrews().size() < 2 || share.getCasts().empty())
+			return FC_INVALID_STATE;
+		share.setProgress(request.turn, request.brew_count, request.opponent_brew_count);
+
+		if (request.turn == 0)
+		{
+			FirstAI ai(share, arena);
+			return search(ai, request, result);
+		}
+		else
+		{
+			TurnAI ai(share, arena);
+			return search(ai, request, result);
+		}
+	}
+} // namespace
+
+extern "C" FC_API int fc_analyze_batch(const FcRequest *requests, FcResult *results, size_t count, const FcOptions *options)
+{
+	if (count == 0)
+		return 0;
+	if (requests == nullptr || results == nullptr)
+		return static_cast<int>(count);
+
+	size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	size_t arenaMB = DefaultArenaMB;
+	if (options != nullptr)
+	{
+		if (options->threads > 0)
+			threadCount = static_cast<size_t>(options->threads);
+		if (options->arena_mb > 0)
+			arenaMB = options->arena_mb;
+	}
+	threadCount = std::min(threadCount, count);
+
+	std::atomic<size_t> next{0};
+	std::atomic<int> failed{0};
+
+	const auto worker = [&]() {
+		//スレッドごとに探索用メモリを持ち、局面間で使い回す
+		std::shared_ptr<SearchArena> arena;
+		try
+		{
+			arena = std::make_shared<SearchArena>(arenaMB * 1024 * 1024);
+		}
+		catch (...)
+		{
+		}
+
+		while (true)
+		{
+			const auto index = next++;
+			if (index >= count)
+				break;
+
+			auto &result = results[index];
+			result = FcResult{};
+			try
+			{
+				result.status = (arena ? analyze(arena, requests[index], result) : FC_ERROR);
+			}
+			catch (...)
+			{
+				result.status = FC_ERROR;
+			}
+
+			if (result.status != FC_OK)
+				failed++;
+		}
+	};
+
+	if (threadCount == 1)
+	{
+		worker();
+	}
+	else
+	{
+		std::vector<std::thread> threads;
+		forange(i, threadCount)
+		{
+			threads.emplace_back(worker);
+		}
+		for (auto &thread : threads)
+		{
+			thread.join();
+		}
+	}
+
+	return failed;
+}
@@ -0,0 +1,79 @@
+/**
+ * @brief 局面解析ライブラリのC API
+ *
+ * cmake -S . -B build && cmake --build build --target Analysis
+ * libFallChallenge2020Analysis.so をリンクし、このヘッダを読み込む
+ *
+ * 局面はゲームの1ターン分の入力と同じ形式の文字列で渡す
+ * (アクション数の行、アクションの行、自身と相手の素材所持状態の行)
+ */
+
+#ifndef FALLCHALLENGE2020_ANALYSIS_H
+#define FALLCHALLENGE2020_ANALYSIS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define FC_API __declspec(dllexport)
+#else
+#define FC_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+	/* 結果の状態 */
+	enum
+	{
+		FC_OK = 0,
+		FC_INVALID_STATE = -1, /* 局面の文字列を読み込めない */
+		FC_NO_MOVE = -2,	   /* 探索で手が見つからない */
+		FC_ERROR = -3		   /* 探索中の例外(メモリ不足など) */
+	};
+
+	/* 解析する局面と予算 */
+	typedef struct FcRequest
+	{
+		const char *state;		   /* 1ターン分の入力 */
+		int turn;				   /* 進行ターン数(0で1ターン目の探索を使う) */
+		int brew_count;			   /* 自身のポーション作成個数 */
+		int opponent_brew_count;   /* 相手のポーション作成個数 */
+		uint64_t nodes;			   /* 展開ノード数の上限(0:制限時間で打ち切る) */
+		uint32_t milliseconds;	   /* 制限時間(0:既定値) */
+		uint64_t seed;			   /* 乱数のシード(0:既定の状態) */
+	} FcRequest;
+
+	/* 解析結果 */
+	typedef struct FcResult
+	{
+		int status;			 /* FC_OK など */
+		char command[64];	 /* 最善手のコマンド */
+		char pv[512];		 /* 最善手順(";"区切り、探索中に取得したスペルのIDは未確定のため0) */
+		double score;		 /* 最善手順の評価値 */
+		uint64_t nodes;		 /* 展開したノード数 */
+		double milliseconds; /* 探索時間 */
+	} FcResult;
+
+	/* バッチ全体の設定(NULLで既定値) */
+	typedef struct FcOptions
+	{
+		int threads;	 /* 並行数(0:ハードウェアのスレッド数) */
+		size_t arena_mb; /* スレッドごとの探索用メモリ(0:既定値) */
+	} FcOptions;
+
+	/**
+	 * 局面をまとめて解析する
+	 * results[i] に requests[i] の結果を書き込む(各局面は独立に探索する)
+	 *
+	 * 戻り値: FC_OK 以外の結果の個数
+	 */
+	FC_API int fc_analyze_batch(const FcRequest *requests, FcResult *results, size_t count, const FcOptions *options);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
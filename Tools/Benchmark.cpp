@@ -0,0 +1,537 @@
+/**
+ * @brief 探索の主要処理のマイクロベンチマーク
+ *
+ * cmake -S . -B build && cmake --build build --target Benchmark
+ * ./build/Benchmark [計測回数]
+ *
+ * 計測の前にTierのSWAR演算をレーンごとの計算と照合し、一致しなければ終了コード1を返す
+ */
+
+#define NO_MAIN
+#include "../FallChallenge2020/main.cpp"
+
+#include <cstdio>
+
+namespace
+{
+	//入力サンプルの1ターン目
+	const std::string FirstTurn = R"(19
+67 BREW 0 -2 -1 -1 15 3 4 0 0
+62 BREW 0 -2 0 -3 17 1 4 0 0
+61 BREW 0 0 0 -4 16 0 0 0 0
+57 BREW 0 0 -2 -2 14 0 0 0 0
+74 BREW -3 -1 -1 -1 14 0 0 0 0
+22 LEARN 0 2 -2 1 0 0 0 0 1
+36 LEARN 0 -3 3 0 0 1 0 0 1
+4 LEARN 3 0 0 0 0 2 0 0 0
+19 LEARN 0 2 -1 0 0 3 0 0 1
+7 LEARN 3 0 1 -1 0 4 0 0 1
+15 LEARN 0 2 0 0 0 5 0 0 0
+78 CAST 2 0 0 0 0 -1 -1 1 0
+79 CAST -1 1 0 0 0 -1 -1 1 0
+80 CAST 0 -1 1 0 0 -1 -1 1 0
+81 CAST 0 0 -1 1 0 -1 -1 1 0
+82 OPPONENT_CAST 2 0 0 0 0 -1 -1 1 0
+83 OPPONENT_CAST -1 1 0 0 0 -1 -1 1 0
+84 OPPONENT_CAST 0 -1 1 0 0 -1 -1 1 0
+85 OPPONENT_CAST 0 0 -1 1 0 -1 -1 1 0
+3 0 0 0 0
+3 0 0 0 0
+)";
+
+	//入力サンプルの21ターン目
+	const std::string MiddleTurn = R"(40
+62 BREW 0 -2 0 -3 19 3 2 0 0
+61 BREW 0 0 0 -4 17 1 4 0 0
+57 BREW 0 0 -2 -2 14 0 0 0 0
+74 BREW -3 -1 -1 -1 14 0 0 0 0
+72 BREW 0 -2 -2 -2 19 0 0 0 0
+9 LEARN 2 -3 2 0 0 0 0 0 1
+29 LEARN -5 0 0 2 0 1 0 0 1
+5 LEARN 2 3 -2 0 0 2 0 0 1
+6 LEARN 2 1 -2 1 0 3 0 0 1
+31 LEARN 0 3 2 -2 0 4 0 0 1
+1 LEARN 3 -1 0 0 0 5 0 0 1
+78 CAST 2 0 0 0 0 -1 -1 1 0
+79 CAST -1 1 0 0 0 -1 -1 1 0
+80 CAST 0 -1 1 0 0 -1 -1 1 0
+81 CAST 0 0 -1 1 0 -1 -1 1 0
+86 CAST 0 2 -2 1 0 -1 -1 0 1
+88 CAST 0 -3 3 0 0 -1 -1 0 1
+90 CAST 3 0 0 0 0 -1 -1 1 0
+92 CAST 0 2 -1 0 0 -1 -1 1 1
+94 CAST 0 2 0 0 0 -1 -1 1 0
+96 CAST 3 0 1 -1 0 -1 -1 1 1
+98 CAST 0 0 2 -1 0 -1 -1 1 1
+101 CAST 4 1 -1 0 0 -1 -1 1 1
+103 CAST 0 0 -3 3 0 -1 -1 1 1
+105 CAST -3 3 0 0 0 -1 -1 1 1
+82 OPPONENT_CAST 2 0 0 0 0 -1 -1 1 0
+83 OPPONENT_CAST -1 1 0 0 0 -1 -1 0 0
+84 OPPONENT_CAST 0 -1 1 0 0 -1 -1 0 0
+85 OPPONENT_CAST 0 0 -1 1 0 -1 -1 0 0
+87 OPPONENT_CAST 0 2 -2 1 0 -1 -1 0 1
+89 OPPONENT_CAST 0 -3 3 0 0 -1 -1 0 1
+91 OPPONENT_CAST 3 0 0 0 0 -1 -1 1 0
+93 OPPONENT_CAST 0 2 -1 0 0 -1 -1 1 1
+95 OPPONENT_CAST 0 2 0 0 0 -1 -1 0 0
+97 OPPONENT_CAST 3 0 1 -1 0 -1 -1 1 1
+99 OPPONENT_CAST 0 0 2 -1 0 -1 -1 1 1
+100 OPPONENT_CAST 0 0 1 0 0 -1 -1 0 0
+102 OPPONENT_CAST 4 1 -1 0 0 -1 -1 1 1
+104 OPPONENT_CAST 0 0 -3 3 0 -1 -1 1 1
+106 OPPONENT_CAST -3 3 0 0 0 -1 -1 0 1
+0 6 0 3 15
+0 2 1 1 15
+)";
+
+	/**
+	 * @brief 最適化で計算が消されないようにする
+	 *
+	 */
+	template <class Type>
+	inline void keep(const Type &value)
+	{
+		asm volatile(""
+					 :
+					 : "r,m"(value)
+					 : "memory");
+	}
+
+	/**
+	 * @brief 入力をゲームの状態に読み込む
+	 *
+	 */
+	void load(Share &share, const std::string &text)
+	{
+		share = Share();
+
+		std::istringstream iss(text);
+		Input input(share, iss);
+		while (input.loop())
+		{
+		}
+	}
+} // namespace
+
+class Benchmark
+{
+public:
+	using BenchAI = AI<>;
+	using BucketAI = AI<BenchAI::DefaultHorizon, 45, BenchAI::MaxHorizon, true>;
+	using Node = BenchAI::Node;
+
+private:
+	struct Result
+	{
+		std::string name;
+		double mean = 0;
+		double stddev = 0;
+		double min = 0;
+	};
+
+	size_t repeat;
+	Share share;
+	std::vector<Result> results;
+	XoShiro128 xoshiro;
+
+	/**
+	 * @brief 計測を行う
+	 *
+	 * @param name 計測名
+	 * @param ops 1回の計測での処理回数
+	 * @param setup 計測前の準備(計測時間に含まない)
+	 * @param func 計測する処理
+	 * @param teardown 計測後の後始末(計測時間に含まない)
+	 */
+	template <class Setup, class Func, class Teardown>
+	void measure(const std::string &name, const size_t ops, Setup setup, Func func, Teardown teardown)
+	{
+		std::vector<double> samples;
+
+		Stopwatch sw;
+		forange(r, repeat)
+		{
+			setup();
+			sw.start();
+			func();
+			sw.stop();
+			teardown();
+
+			samples.push_back(static_cast<double>(sw.nanoseconds()) / ops);
+		}
+
+		double mean = 0;
+		for (const auto sample : samples)
+			mean += sample;
+		mean /= samples.size();
+
+		double variance = 0;
+		for (const auto sample : samples)
+			variance += (sample - mean) * (sample - mean);
+		variance /= samples.size();
+
+		results.push_back(Result{name, mean, std::sqrt(variance), *std::min_element(samples.cbegin(), samples.cend())});
+	}
+	template <class Func>
+	void measure(const std::string &name, const size_t ops, Func func)
+	{
+		measure(name, ops, []() {}, func, []() {});
+	}
+
+	Tier randomTier(const int min, const int max)
+	{
+		const auto value = [&]() {
+			return static_cast<Tier::value_type>(min + static_cast<int>(xoshiro.next() % static_cast<unsigned int>(max - min + 1)));
+		};
+		return Tier(value(), value(), value(), value());
+	}
+
+	/**
+	 * @brief 共有データから探索の初期ノードを作成する
+	 *
+	 */
+	static BenchAI::DataPack prepare(BenchAI &ai)
+	{
+		const auto &share = ai.share;
+
+		ai.pool.clear();
+		ai.gameTurn = share.getTurn();
+		ai.opponentInventoryScore = share.getOpponentInventory().inv.getScore();
+
+		ai.dominanceFilter.clear();
+		ai.thinkOpponent();
+		ai.pool.clear();
+		ai.dominanceFilter.clear();
+
+		const auto root = ai.createRoot(share.getInventory(), share.getCasts(), share.getBrewCount());
+		ai.inventoryDistance.build(share.getCasts(), share.getBrews());
+
+		ai.evaluate = &BenchAI::evaluateMy;
+		ai.potionLimit = Object::PotionLimit;
+
+		return root;
+	}
+
+	void tier()
+	{
+		constexpr size_t Size = 1 << 12;
+		constexpr size_t Ops = 1 << 20;
+
+		std::vector<Tier> a(Size), b(Size);
+		for (auto &t : a)
+			t = randomTier(0, 4);
+		for (auto &t : b)
+			t = randomTier(-3, 3);
+
+		measure("Tier::operator+", Ops, [&]() {
+			forange(i, Ops)
+			{
+				keep(a[i & (Size - 1)] + b[i & (Size - 1)]);
+			}
+		});
+
+		measure("Tier::isAccept", Ops, [&]() {
+			forange(i, Ops)
+			{
+				keep(a[i & (Size - 1)].isAccept(b[i & (Size - 1)]));
+			}
+		});
+	}
+
+	/**
+	 * @brief TierのSWAR演算がレーンごとの計算と一致するか
+	 *
+	 * @return size_t 一致しなかった組の数
+	 */
+	size_t verifyTier()
+	{
+		constexpr size_t Pairs = 3'000'000;
+
+		const auto lane = [](const Tier &tier, const int i) {
+			const Tier::value_type lanes[] = {tier.tier0, tier.tier1, tier.tier2, tier.tier3};
+			return static_cast<int>(lanes[i]);
+		};
+
+		size_t mismatch = 0;
+		const auto expect = [&](const bool ok, const char *name, const Tier &a, const Tier &b) {
+			if (ok)
+				return;
+			if (mismatch++ < 10)
+				std::fprintf(stderr, "Tier::%s mismatch: (%d %d %d %d) (%d %d %d %d)\n", name,
+							 lane(a, 0), lane(a, 1), lane(a, 2), lane(a, 3), lane(b, 0), lane(b, 1), lane(b, 2), lane(b, 3));
+		};
+
+		forange(n, Pairs)
+		{
+			//所持素材とスペルの範囲に加え、全範囲(桁上がりと符号の境界)も照合する(合計は所持素材の範囲のみ)
+			const bool full = (n % 3 == 0);
+			const Tier a = (full ? randomTier(-128, 127) : randomTier(0, Object::InventorySize));
+			const Tier b = (full ? randomTier(-128, 127) : randomTier(-5, 5));
+
+			const auto sum = a + b;
+			const auto plus = a.getPlus();
+			int total = 0, score = 0;
+			bool accept = true, addOk = true, plusOk = true;
+			forange(i, 4)
+			{
+				const int s = lane(a, i) + lane(b, i);
+				addOk &= (lane(sum, i) == static_cast<Tier::value_type>(s));
+				plusOk &= (lane(plus, i) == std::max(0, lane(a, i)));
+				accept &= (s >= 0);
+				total += s;
+				if (i > 0)
+					score += lane(a, i);
+			}
+
+			expect(addOk, "operator+", a, b);
+			expect(plusOk, "getPlus", a, b);
+			expect((a == b) == (a.tier0 == b.tier0 && a.tier1 == b.tier1 && a.tier2 == b.tier2 && a.tier3 == b.tier3), "operator==", a, b);
+			expect((a == a), "operator==", a, a);
+			if (!full)
+			{
+				expect(a.getSum() == static_cast<Tier::value_type>(lane(a, 0) + lane(a, 1) + lane(a, 2) + lane(a, 3)), "getSum", a, b);
+				expect(a.getScore() == static_cast<Tier::value_type>(score), "getScore", a, b);
+				expect(a.isAccept(b) == (accept && total <= Object::InventorySize), "isAccept", a, b);
+			}
+		}
+
+		return mismatch;
+	}
+
+	void magicBit()
+	{
+		constexpr size_t Ops = 1 << 20;
+
+		MagicBit magic;
+
+		measure("MagicBit::setCast", Ops, [&]() {
+			forange(i, Ops)
+			{
+				magic.setCast((i & 2) != 0, (i & 1) != 0);
+				keep(magic);
+			}
+		});
+	}
+
+	void memoryPool()
+	{
+		constexpr size_t Ops = 1 << 16;
+
+		BenchAI ai(share);
+		auto &pool = ai.pool;
+
+		std::vector<Node *> nodes(Ops);
+
+		measure(
+			"MemoryPool::get", Ops, [&]() { pool.clear(); },
+			[&]() {
+				forange(i, Ops)
+				{
+					nodes[i] = static_cast<Node *>(pool.get());
+				}
+			},
+			[]() {});
+
+		measure(
+			"MemoryPool::release", Ops,
+			[&]() {
+				pool.clear();
+				forange(i, Ops)
+				{
+					nodes[i] = static_cast<Node *>(pool.get());
+				}
+			},
+			[&]() {
+				forange(i, Ops)
+				{
+					pool.release(nodes[i]);
+				}
+			},
+			[]() {});
+	}
+
+	template <class Queue>
+	void queue(const std::string &name, const std::vector<BenchAI::Child> &nodes)
+	{
+		Queue queue;
+
+		measure(
+			name + "::push", nodes.size(), [&]() { queue = Queue(); },
+			[&]() {
+				for (const auto &child : nodes)
+					queue.push(child);
+			},
+			[]() {});
+
+		measure(
+			name + "::pop", nodes.size(),
+			[&]() {
+				queue = Queue();
+				for (const auto &child : nodes)
+					queue.push(child);
+			},
+			[&]() {
+				forange(i, nodes.size())
+				{
+					keep(queue.top());
+					queue.pop();
+				}
+			},
+			[]() {});
+	}
+
+	void priorityQueue()
+	{
+		constexpr size_t Ops = 1 << 16;
+
+		BenchAI ai(share);
+		auto &pool = ai.pool;
+
+		pool.clear();
+		std::vector<BenchAI::Child> nodes(Ops);
+		for (auto &child : nodes)
+		{
+			const auto node = new (pool.get()) Node();
+			node->score = static_cast<Score>(xoshiro.nextDouble() * 100 * ScoreOne);
+			child = BenchAI::Child{node, node->score, 0, CommandPack{}, 0, 0};
+		}
+
+		queue<BenchAI::PriorityQueue>("PriorityQueue", nodes);
+		queue<BucketQueue<BenchAI::Child, BenchAI::ChildLess>>("BucketQueue", nodes);
+	}
+
+	void search()
+	{
+		constexpr size_t Ops = 1 << 10;
+
+		load(share, FirstTurn + MiddleTurn);
+
+		BenchAI ai(share);
+		const auto root = prepare(ai);
+
+		BenchAI::PriorityQueue next;
+		BenchAI::PriorityQueue last;
+
+		const auto expand = [&](const std::string &name, const auto &func) {
+			measure(
+				name, Ops, []() {},
+				[&]() {
+					forange(i, Ops)
+					{
+						ai.dominanceFilter.clear();
+						func();
+					}
+				},
+				[&]() {
+					for (auto queue : {&next, &last})
+					{
+						while (!queue->empty())
+							queue->pop();
+					}
+					root->references = 1;
+				});
+		};
+
+		expand("AI::searchBrew", [&]() {
+			forange(i, Object::BrewSize)
+			{
+				ai.searchBrew(i, 0, root, next, last);
+			}
+		});
+		expand("AI::searchLearn", [&]() {
+			forange(i, Object::LearnSize)
+			{
+				ai.searchLearn(i, 0, root, next);
+			}
+		});
+		expand("AI::searchCast", [&]() {
+			for (auto mask = root->castMask; mask != 0; mask &= (mask - 1))
+			{
+				const auto i = static_cast<size_t>(lowestBit(mask));
+				ai.searchCast(i, root->magicList[i], 0, root, next);
+			}
+		});
+		expand("AI::searchRest", [&]() {
+			ai.searchRest(0, root, next);
+		});
+	}
+
+	void think()
+	{
+		load(share, FirstTurn + MiddleTurn);
+
+		BenchAI ai(share);
+
+		measure("AI::think", 1, [&]() {
+			keep(ai.think());
+		});
+
+		//展開ノード数を固定した探索(1ノード当たり)
+		constexpr size_t Nodes = 20000;
+		ai.setNodeBudget(Nodes, Nodes / 10);
+		measure("AI::think/node", Nodes, [&]() {
+			keep(ai.think());
+		});
+
+		BucketAI bucketAI(share);
+		bucketAI.setNodeBudget(Nodes, Nodes / 10);
+		measure("AI::think/node(bucket)", Nodes, [&]() {
+			keep(bucketAI.think());
+		});
+	}
+
+public:
+	Benchmark(const size_t repeat) : repeat(std::max<size_t>(2, repeat)) {}
+
+	/**
+	 * @brief 計測前の照合
+	 *
+	 * @return true 全て一致した
+	 */
+	bool verify()
+	{
+		const auto mismatch = verifyTier();
+		if (mismatch > 0)
+			std::fprintf(stderr, "Tier: %zu mismatches\n", mismatch);
+
+		return mismatch == 0;
+	}
+
+	void run()
+	{
+		tier();
+		magicBit();
+		memoryPool();
+		priorityQueue();
+		search();
+		think();
+	}
+
+	void print() const
+	{
+		std::printf("%-28s %14s %12s %14s\n", "name", "ns/op", "stddev", "min ns/op");
+		for (const auto &result : results)
+		{
+			std::printf("%-28s %14.2f %12.2f %14.2f\n", result.name.c_str(), result.mean, result.stddev, result.min);
+		}
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	unsigned long long repeat = 10;
+	if (argc > 1 && !parseNumber(argv[1], repeat))
+	{
+		std::fprintf(stderr, "計測回数が数値ではありません:%s\n", argv[1]);
+		return 2;
+	}
+
+	Benchmark benchmark(repeat);
+	if (!benchmark.verify())
+		return 1;
+	benchmark.run();
+	benchmark.print();
+
+	return 0;
+}
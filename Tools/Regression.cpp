@@ -0,0 +1,450 @@
+/**
+ * @brief 記録した入力を繰り返し思考させ、探索速度の劣化と応答期限の超過を検出する
+ *
+ * cmake -S . -B build && cmake --build build --target Regression
+ * ./build/Regression [-r 繰り返し回数] [-t 許容する劣化(%)] [-b 基準値ファイル] [--update] [入力ログ...]
+ *
+ * 既定では入力サンプル(FallChallenge2020/入力サンプル.txt)と自己対戦の入力ログ(Tools/RegressionLogs/、SpellValue --logで生成)を
+ * 次の2通りで思考し、全ログを合わせた各項目の繰り返しごとの中央値を
+ * 基準値ファイル(Tools/RegressionBaseline.txt)と比べて許容を超えて劣化した項目があれば終了コード1を返す
+ * - budget_*: 展開ノード数で打ち切る(応答期限なし、乱数固定)。1ノードあたりの時間で探索速度の劣化を見る
+ * - それ以外: 本番と同じ制限時間で打ち切る。思考時間は制限時間に張り付くため、応答期限を守れているかのみを見る
+ * 基準値ファイルが無い、読み込めない、または項目が欠けている場合は終了コード2を返す
+ * 基準値は計測したマシンに依存するため、マシンを変えた場合や意図して性能が変わった場合は--updateで書き直す
+ * 既定のファイルはCMakeで与えるソースディレクトリ(REGRESSION_SOURCE_DIR)から探す(未定義の場合は作業ディレクトリから)
+ */
+
+#define NO_MAIN
+#include "../FallChallenge2020/main.cpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+
+namespace
+{
+	//時間の項目はスケジューラの切り替え(数ms)で揺らぐため、割合に加えてこの時間までの増加は許容する
+	constexpr double SlackMilliseconds = 5.0;
+	//制限時間を超えたターンの割合は、割合に加えてこの値(1ゲームに1ターン程度)までの増加は許容する
+	constexpr double SlackLateRate = 0.03;
+
+	//展開ノード数で打ち切る計測の設定(1ターン目、2ターン目以降、相手の探索)
+	constexpr size_t BudgetFirstNodes = 100000;
+	constexpr size_t BudgetNodes = 30000;
+	constexpr size_t BudgetSurveyNodes = 3000;
+	constexpr uint64_t BudgetSeed = 7;
+
+#ifdef REGRESSION_SOURCE_DIR
+	const std::string SourceDir = REGRESSION_SOURCE_DIR "/";
+#else
+	const std::string SourceDir;
+#endif
+	//既定の入力ログ(SourceDirからの相対パス)
+	const char *const DefaultLogs[] = {
+		"FallChallenge2020/入力サンプル.txt",
+		"Tools/RegressionLogs/selfplay_seed1.txt",
+		"Tools/RegressionLogs/selfplay_seed4.txt",
+	};
+
+	/**
+	 * @brief 計測項目の良い方向
+	 *
+	 */
+	enum class Better
+	{
+		Lower,
+		Higher,
+		//参考値(比較しない)
+		None
+	};
+
+	struct Metric
+	{
+		std::string name;
+		double value = 0;
+		Better better = Better::None;
+		//許容する劣化に加える値(揺らぎの大きい項目)
+		double slack = 0;
+	};
+
+	/**
+	 * @brief 1回分の計測結果
+	 *
+	 */
+	struct Record
+	{
+		//入力の読み込みから思考の終了まで
+		std::vector<double> firstMilliseconds;
+		//2ターン目以降
+		std::vector<double> turnMilliseconds;
+		//応答期限を過ぎた時間
+		std::vector<double> overshootMilliseconds;
+		int lateTurns = 0;
+		int turns = 0;
+
+		//思考のみの時間と展開ノード数(1ターン目と2ターン目以降)
+		double firstThinkSeconds = 0;
+		size_t firstNodes = 0;
+		double thinkSeconds = 0;
+		size_t nodes = 0;
+
+		size_t poolPeak = 0;
+		size_t poolCapacity = 0;
+		size_t poolPeakTotal = 0;
+
+		/**
+		 * @brief 別のゲームの計測結果を合わせる
+		 *
+		 */
+		void merge(const Record &other)
+		{
+			firstMilliseconds.insert(firstMilliseconds.end(), other.firstMilliseconds.cbegin(), other.firstMilliseconds.cend());
+			turnMilliseconds.insert(turnMilliseconds.end(), other.turnMilliseconds.cbegin(), other.turnMilliseconds.cend());
+			overshootMilliseconds.insert(overshootMilliseconds.end(), other.overshootMilliseconds.cbegin(), other.overshootMilliseconds.cend());
+			lateTurns += other.lateTurns;
+			turns += other.turns;
+
+			firstThinkSeconds += other.firstThinkSeconds;
+			firstNodes += other.firstNodes;
+			thinkSeconds += other.thinkSeconds;
+			nodes += other.nodes;
+
+			poolPeak = std::max(poolPeak, other.poolPeak);
+			poolCapacity = std::max(poolCapacity, other.poolCapacity);
+			poolPeakTotal += other.poolPeakTotal;
+		}
+	};
+
+	double percentile(std::vector<double> values, const double rate)
+	{
+		if (values.empty())
+			return 0;
+
+		std::sort(values.begin(), values.end());
+		const auto index = static_cast<size_t>(std::ceil(rate * values.size()));
+		return values[std::clamp<size_t>(index, 1, values.size()) - 1];
+	}
+
+	/**
+	 * @brief 入力ログを1ゲーム分、思考させる
+	 *
+	 */
+	Record play(const std::string &log, const Engine::Option &option)
+	{
+		Record record;
+		Engine engine(option);
+
+		std::istringstream iss(log);
+		bool first = true;
+		while (true)
+		{
+			if (!engine.read(iss))
+				break;
+
+			Stopwatch think;
+			think.start();
+			engine.think();
+			think.stop();
+
+			//本番と同じく最初の行を受け取ってからの時間とする
+			const auto milliseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - engine.getArrival()).count() / 1000.0;
+			const auto limit = (first ? option.firstTurnMilliseconds : option.turnMilliseconds);
+			const auto overshoot = std::max(0.0, milliseconds - (limit - option.marginMilliseconds));
+			record.overshootMilliseconds.push_back(overshoot);
+			if (milliseconds > limit)
+				record.lateTurns++;
+			record.turns++;
+
+			if (first)
+			{
+				record.firstMilliseconds.push_back(milliseconds);
+				record.firstThinkSeconds += think.microseconds() / 1e6;
+				record.firstNodes += engine.getExpandCount();
+			}
+			else
+			{
+				record.turnMilliseconds.push_back(milliseconds);
+				record.thinkSeconds += think.microseconds() / 1e6;
+				record.nodes += engine.getExpandCount();
+			}
+			first = false;
+
+			record.poolPeak = std::max(record.poolPeak, engine.getPoolPeak());
+			record.poolCapacity = std::max(record.poolCapacity, engine.getPoolCapacity());
+			record.poolPeakTotal += engine.getPoolPeak();
+		}
+
+		return record;
+	}
+
+	/**
+	 * @brief 全ての入力ログを1ゲームずつ思考させる
+	 *
+	 */
+	Record playAll(const std::vector<std::string> &logs, const Engine::Option &option)
+	{
+		Record record;
+		for (const auto &log : logs)
+		{
+			record.merge(play(log, option));
+		}
+
+		return record;
+	}
+
+	/**
+	 * @brief 本番と同じ制限時間で思考した結果の項目(応答期限を守れているか)
+	 *
+	 */
+	void summarizeTimed(const Record &record, std::vector<Metric> &metrics)
+	{
+		const auto &turn = record.turnMilliseconds;
+
+		metrics.push_back(Metric{"first_ms", percentile(record.firstMilliseconds, 0.5), Better::Lower, SlackMilliseconds});
+		metrics.push_back(Metric{"think_p50_ms", percentile(turn, 0.50), Better::Lower, SlackMilliseconds});
+		metrics.push_back(Metric{"think_p95_ms", percentile(turn, 0.95), Better::Lower, SlackMilliseconds});
+		metrics.push_back(Metric{"think_p99_ms", percentile(turn, 0.99), Better::Lower, SlackMilliseconds});
+		metrics.push_back(Metric{"think_max_ms", percentile(turn, 1.0), Better::Lower, SlackMilliseconds});
+		metrics.push_back(Metric{"overshoot_max_ms", percentile(record.overshootMilliseconds, 1.0), Better::Lower, SlackMilliseconds});
+		metrics.push_back(Metric{"late_rate", record.turns > 0 ? static_cast<double>(record.lateTurns) / record.turns : 0, Better::Lower, SlackLateRate});
+		//制限時間で打ち切るため、展開ノード数は探索速度に比例する(参考値)
+		metrics.push_back(Metric{"nodes_per_sec", record.thinkSeconds > 0 ? record.nodes / record.thinkSeconds : 0});
+		metrics.push_back(Metric{"pool_peak", static_cast<double>(record.poolPeak)});
+		metrics.push_back(Metric{"pool_peak_rate", record.poolCapacity > 0 ? static_cast<double>(record.poolPeak) / record.poolCapacity : 0});
+	}
+
+	/**
+	 * @brief 展開ノード数で打ち切って思考した結果の項目(探索速度)
+	 *
+	 */
+	void summarizeBudget(const Record &record, std::vector<Metric> &metrics)
+	{
+		metrics.push_back(Metric{"budget_first_ns_per_node", record.firstNodes > 0 ? record.firstThinkSeconds * 1e9 / record.firstNodes : 0, Better::Lower});
+		metrics.push_back(Metric{"budget_ns_per_node", record.nodes > 0 ? record.thinkSeconds * 1e9 / record.nodes : 0, Better::Lower});
+		metrics.push_back(Metric{"budget_think_p95_ms", percentile(record.turnMilliseconds, 0.95), Better::Lower, SlackMilliseconds});
+		//展開ノード数が同じため、確保数は探索の変更のみで変わる
+		metrics.push_back(Metric{"budget_pool_peak_per_node", record.nodes > 0 ? static_cast<double>(record.poolPeakTotal) / record.nodes : 0, Better::Lower});
+	}
+
+	/**
+	 * @brief 繰り返しごとの計測結果の中央値を取る(1回だけの外れ値で劣化と判定しない)
+	 *
+	 */
+	std::vector<Metric> median(const std::vector<std::vector<Metric>> &runs)
+	{
+		auto metrics = runs.front();
+		forange(i, metrics.size())
+		{
+			std::vector<double> values;
+			for (const auto &run : runs)
+				values.push_back(run[i].value);
+			metrics[i].value = percentile(values, 0.5);
+		}
+
+		return metrics;
+	}
+
+	/**
+	 * @brief 基準値ファイルを読み込む
+	 *
+	 * @return true 読み込めた
+	 * @return false ファイルを開けない、または基準値が無い
+	 */
+	bool readBaseline(const std::string &path, std::map<std::string, double> &baseline)
+	{
+		std::ifstream ifs(path);
+		if (!ifs)
+			return false;
+
+		std::string line;
+		while (std::getline(ifs, line))
+		{
+			if (line.empty() || line[0] == '#')
+				continue;
+
+			std::istringstream iss(line);
+			std::string name;
+			double value = 0;
+			if (iss >> name >> value)
+				baseline[name] = value;
+		}
+
+		return !baseline.empty();
+	}
+
+	bool writeBaseline(const std::string &path, const std::vector<Metric> &metrics, const size_t repeat, const std::vector<std::string> &logPaths)
+	{
+		std::ofstream ofs(path);
+		if (!ofs)
+			return false;
+
+		ofs << std::fixed << std::setprecision(6);
+		ofs << "# Tools/Regressionの基準値(--updateで書き直す)" << std::endl;
+		ofs << "# 繰り返し回数 " << repeat << std::endl;
+		for (const auto &logPath : logPaths)
+		{
+			//ソースディレクトリ内のログはマシンに依存しない相対パスで記録する
+			const auto relative = (!SourceDir.empty() && logPath.compare(0, SourceDir.size(), SourceDir) == 0);
+			ofs << "# 入力ログ " << (relative ? logPath.substr(SourceDir.size()) : logPath) << std::endl;
+		}
+		for (const auto &metric : metrics)
+		{
+			ofs << metric.name << " " << metric.value << std::endl;
+		}
+
+		return true;
+	}
+
+	/**
+	 * @brief 基準値から許容を超えて劣化したか
+	 *
+	 */
+	bool regressed(const Metric &metric, const double base, const double threshold)
+	{
+		switch (metric.better)
+		{
+		case Better::Lower:
+			return metric.value > base * (1 + threshold) + metric.slack;
+		case Better::Higher:
+			return metric.value < base * (1 - threshold) - metric.slack;
+		default:
+			return false;
+		}
+	}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	size_t repeat = 5;
+	double threshold = 0.10;
+	std::string baselinePath = SourceDir + "Tools/RegressionBaseline.txt";
+	std::vector<std::string> logPaths;
+	bool update = false;
+
+	forstep_type(int, i, 1, argc)
+	{
+		const std::string arg = argv[i];
+		unsigned long long value = 0;
+		if (arg == "--update")
+			update = true;
+		else if (arg == "-r" && i + 1 < argc)
+		{
+			if (!parseNumber(argv[++i], value))
+			{
+				std::clog << "繰り返し回数が数値ではありません:" << argv[i] << std::endl;
+				return 2;
+			}
+			repeat = std::max<size_t>(1, value);
+		}
+		else if (arg == "-t" && i + 1 < argc)
+		{
+			if (!parseNumber(argv[++i], value))
+			{
+				std::clog << "許容する劣化が数値ではありません:" << argv[i] << std::endl;
+				return 2;
+			}
+			threshold = value / 100.0;
+		}
+		else if (arg == "-b" && i + 1 < argc)
+			baselinePath = argv[++i];
+		else
+			logPaths.push_back(arg);
+	}
+
+	if (logPaths.empty())
+	{
+		for (const auto path : DefaultLogs)
+			logPaths.push_back(SourceDir + path);
+	}
+
+	std::vector<std::string> logs;
+	for (const auto &logPath : logPaths)
+	{
+		std::ifstream ifs(logPath);
+		if (!ifs)
+		{
+			std::clog << "入力ログを読み込めません:" << logPath << std::endl;
+			return 2;
+		}
+		std::stringstream ss;
+		ss << ifs.rdbuf();
+		logs.push_back(ss.str());
+	}
+
+	std::map<std::string, double> baseline;
+	if (!update && !readBaseline(baselinePath, baseline))
+	{
+		std::clog << "基準値を読み込めません(--updateで作成する):" << baselinePath << std::endl;
+		return 2;
+	}
+
+	const Engine::Option timed;
+	Engine::Option budget;
+	budget.firstNodes = BudgetFirstNodes;
+	budget.nodes = BudgetNodes;
+	budget.surveyNodes = BudgetSurveyNodes;
+	budget.useSeed = true;
+	budget.seed = BudgetSeed;
+
+	//探索のログは捨てる(進捗はstd::clogに出力する)
+	std::cerr.rdbuf(nullptr);
+
+	std::vector<std::vector<Metric>> runs;
+	forange(i, repeat)
+	{
+		std::vector<Metric> metrics;
+		summarizeBudget(playAll(logs, budget), metrics);
+		summarizeTimed(playAll(logs, timed), metrics);
+		runs.push_back(metrics);
+		std::clog << "@" << (i + 1) << "/" << repeat << std::endl;
+	}
+
+	const auto metrics = median(runs);
+
+	if (update)
+	{
+		if (!writeBaseline(baselinePath, metrics, repeat, logPaths))
+		{
+			std::clog << "基準値ファイルを書き込めません:" << baselinePath << std::endl;
+			return 2;
+		}
+		for (const auto &metric : metrics)
+		{
+			std::printf("%-26s %14.3f\n", metric.name.c_str(), metric.value);
+		}
+		return 0;
+	}
+
+	int regressions = 0;
+	int missing = 0;
+	std::printf("# budget_*は探索速度、それ以外の時間の項目は応答期限を守れているかのみを見る\n");
+	std::printf("%-26s %14s %14s %9s\n", "name", "value", "baseline", "change");
+	for (const auto &metric : metrics)
+	{
+		const auto it = baseline.find(metric.name);
+		if (it == baseline.end())
+		{
+			if (metric.better != Better::None)
+				missing++;
+			std::printf("%-26s %14.3f %14s %9s\n", metric.name.c_str(), metric.value, "-", "-");
+			continue;
+		}
+
+		const auto base = it->second;
+		const auto change = (base != 0 ? 100.0 * (metric.value - base) / base : 0.0);
+		const auto bad = regressed(metric, base, threshold);
+		if (bad)
+			regressions++;
+
+		std::printf("%-26s %14.3f %14.3f %+8.1f%%%s\n", metric.name.c_str(), metric.value, base, change, bad ? " REGRESSION" : "");
+	}
+
+	if (missing > 0)
+	{
+		std::clog << "基準値に無い項目があります(--updateで書き直す):" << baselinePath << std::endl;
+		return 2;
+	}
+
+	return regressions > 0 ? 1 : 0;
+}
@@ -0,0 +1,556 @@
+/**
+ * @brief 自己対戦でスペル取得の価値を推定し、[進行][取得済みスペル数][スペル]のテーブルを出力する
+ *
+ * cmake -S . -B build && cmake --build build --target SpellValue
+ * ./build/SpellValue [-g 対戦数] [-s シード] [-j スレッド数] [-n 1ターンの展開ノード数] > table.txt
+ * ./build/SpellValue --log [-s シード] [-n 1ターンの展開ノード数] > game.txt (1対戦の先手への入力を出力する。Tools/Regressionの入力ログ)
+ *
+ * スペル取得の評価を見直すときの参考に使う(AIはテーブルを使わない)
+ * 取得したスペルごとに取得したプレイヤーの最終得点を集計し、同じ条件(進行と取得済みスペル数)の取得の平均との差を価値とする
+ * (同じAI同士の対戦は対称になりやすく、得点差では差が出ないため)
+ */
+
+#define NO_MAIN
+#include "../FallChallenge2020/main.cpp"
+
+#include <atomic>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <thread>
+
+namespace
+{
+	constexpr int TurnLimit = 100;
+	//初期スペル(CastSpellの末尾)
+	constexpr size_t BaseSpellSize = CastSpellSize - LearnSpellSize;
+	//件数の少ない条件を平均に寄せる重み(件数換算)
+	constexpr double Prior = 20.0;
+
+	constexpr int PhaseTurns = 10;
+	constexpr size_t PhaseSize = 4;
+	constexpr size_t OwnedSize = 4;
+	//値の単位(1点をScaleとする)
+	constexpr int Scale = 10;
+
+	/**
+	 * @brief ゲームの進行の区分を取得する
+	 *
+	 * @param turn ゲームのターン数
+	 * @return size_t 区分
+	 */
+	constexpr size_t phaseOf(const int turn)
+	{
+		return std::min(static_cast<size_t>(std::max(0, turn) / PhaseTurns), PhaseSize - 1);
+	}
+
+	/**
+	 * @brief 取得済みスペル数の区分を取得する(0, 1-2, 3-5, 6以上)
+	 *
+	 * @param learned 取得済みスペル数(初期スペルを除く)
+	 * @return size_t 区分
+	 */
+	constexpr size_t ownedOf(const int learned)
+	{
+		return learned <= 0 ? 0 : learned <= 2 ? 1 : learned <= 5 ? 2 : 3;
+	}
+
+	using Inventory = std::array<int, 4>;
+
+	Inventory toInventory(const Tier &tier)
+	{
+		return Inventory{tier.tier0, tier.tier1, tier.tier2, tier.tier3};
+	}
+
+	struct Spell
+	{
+		int actionId = 0;
+		Inventory delta{};
+		bool repeatable = false;
+		bool castable = true;
+	};
+
+	struct Tome
+	{
+		size_t learnIndex = 0;
+		int tax = 0;
+	};
+
+	/**
+	 * @brief スペル取得の記録
+	 *
+	 */
+	struct Learned
+	{
+		size_t spell = 0;
+		int turn = 0;
+		int owned = 0;
+	};
+
+	struct Player
+	{
+		Inventory inventory{3, 0, 0, 0};
+		int score = 0;
+		int brewCount = 0;
+		std::vector<Spell> spells;
+		std::vector<Learned> learns;
+
+		int total() const
+		{
+			return score + inventory[1] + inventory[2] + inventory[3];
+		}
+	};
+
+	/**
+	 * @brief 対戦の審判(ゲームのルールの再現)
+	 *
+	 */
+	class Game
+	{
+	private:
+		std::array<Player, 2> players;
+		std::vector<size_t> brewDeck;
+		std::vector<size_t> tomeDeck;
+		std::vector<size_t> brews;
+		std::vector<Tome> tomes;
+		int bonus3 = 4;
+		int bonus1 = 4;
+		int nextActionId = 86;
+		int turn = 0;
+
+		static bool accept(const Inventory &inventory)
+		{
+			int sum = 0;
+			for (const auto value : inventory)
+			{
+				if (value < 0)
+					return false;
+				sum += value;
+			}
+			return sum <= Object::InventorySize;
+		}
+
+		static Inventory add(const Inventory &a, const Inventory &b, const int times = 1)
+		{
+			Inventory result;
+			forange(i, result.size())
+			{
+				result[i] = a[i] + b[i] * times;
+			}
+			return result;
+		}
+
+		int bonus(const size_t slot) const
+		{
+			if (slot == 0)
+				return bonus3 > 0 ? 3 : (bonus1 > 0 ? 1 : 0);
+			if (slot == 1 && bonus3 > 0)
+				return bonus1 > 0 ? 1 : 0;
+			return 0;
+		}
+
+		int bonusCount(const size_t slot) const
+		{
+			if (slot == 0)
+				return bonus3 > 0 ? bonus3 : bonus1;
+			if (slot == 1 && bonus3 > 0)
+				return bonus1;
+			return 0;
+		}
+
+		void useBonus(const size_t slot)
+		{
+			const auto value = bonus(slot);
+			if (value == 3)
+				bonus3--;
+			else if (value == 1)
+				bonus1--;
+		}
+
+		static std::string line(const int id, const std::string &type, const Inventory &delta, const int price, const int tomeIndex, const int taxCount, const int castable, const int repeatable)
+		{
+			std::stringstream ss;
+			ss << id << " " << type << " " << delta[0] << " " << delta[1] << " " << delta[2] << " " << delta[3] << " "
+			   << price << " " << tomeIndex << " " << taxCount << " " << castable << " " << repeatable;
+			return ss.str();
+		}
+
+	public:
+		Game(std::mt19937 &engine)
+		{
+			brewDeck.resize(BrewPostionSize);
+			tomeDeck.resize(LearnSpellSize);
+			std::iota(brewDeck.begin(), brewDeck.end(), 0);
+			std::iota(tomeDeck.begin(), tomeDeck.end(), 0);
+			std::shuffle(brewDeck.begin(), brewDeck.end(), engine);
+			std::shuffle(tomeDeck.begin(), tomeDeck.end(), engine);
+
+			forange(i, Object::BrewSize)
+			{
+				brews.push_back(brewDeck.back());
+				brewDeck.pop_back();
+			}
+			forange(i, Object::LearnSize)
+			{
+				tomes.push_back(Tome{tomeDeck.back(), 0});
+				tomeDeck.pop_back();
+			}
+
+			forange(p, players.size())
+			{
+				forange(i, BaseSpellSize)
+				{
+					const auto &cast = CastSpell[LearnSpellSize + i];
+					players[p].spells.push_back(Spell{static_cast<int>(78 + p * BaseSpellSize + i), toInventory(cast.delta), false, true});
+				}
+			}
+		}
+
+		/**
+		 * @brief プレイヤーから見た1ターン分の入力を作成する
+		 *
+		 */
+		std::string input(const size_t p) const
+		{
+			std::vector<std::string> lines;
+
+			forange(i, brews.size())
+			{
+				const auto &brew = BrewPostion[brews[i]];
+				lines.push_back(line(brew.actionId, Object::RoundActionBrew, toInventory(brew.delta), brew.price + bonus(i), bonus(i), bonusCount(i), 0, 0));
+			}
+			forange(i, tomes.size())
+			{
+				const auto &learn = LearnSpell[tomes[i].learnIndex];
+				lines.push_back(line(learn.actionId, Object::RoundActionLearn, toInventory(learn.delta), 0, static_cast<int>(i), tomes[i].tax, 0, learn.repeatable ? 1 : 0));
+			}
+			for (const auto &spell : players[p].spells)
+			{
+				lines.push_back(line(spell.actionId, Object::RoundActionCast, spell.delta, 0, -1, -1, spell.castable ? 1 : 0, spell.repeatable ? 1 : 0));
+			}
+			for (const auto &spell : players[1 - p].spells)
+			{
+				lines.push_back(line(spell.actionId, Object::RoundActionOpponentCast, spell.delta, 0, -1, -1, spell.castable ? 1 : 0, spell.repeatable ? 1 : 0));
+			}
+
+			std::string text = std::to_string(lines.size()) + "\n";
+			for (const auto &l : lines)
+				text += l + "\n";
+			forange(i, players.size())
+			{
+				const auto &player = players[i == 0 ? p : 1 - p];
+				const auto &inv = player.inventory;
+				text += std::to_string(inv[0]) + " " + std::to_string(inv[1]) + " " + std::to_string(inv[2]) + " " + std::to_string(inv[3]) + " " + std::to_string(player.score) + "\n";
+			}
+
+			return text;
+		}
+
+		/**
+		 * @brief 両プレイヤーのコマンドを同時に処理する(不正なコマンドはWAIT)
+		 *
+		 */
+		void play(const std::array<std::string, 2> &commands)
+		{
+			std::array<int, 2> brewed{-1, -1};
+			std::array<int, 2> learned{-1, -1};
+
+			forange(p, players.size())
+			{
+				auto &player = players[p];
+				std::istringstream iss(commands[p]);
+				std::string type, repeat;
+				int id = 0, times = 1;
+				iss >> type >> id >> repeat;
+				//回数の後ろにはメッセージが続く
+				if (type == Object::RoundActionCast && !repeat.empty() && std::all_of(repeat.cbegin(), repeat.cend(), ::isdigit))
+					times = std::stoi(repeat);
+
+				if (type == Object::RoundActionBrew)
+				{
+					forange(i, brews.size())
+					{
+						const auto &brew = BrewPostion[brews[i]];
+						const auto next = add(player.inventory, toInventory(brew.delta));
+						if (brew.actionId == id && accept(next))
+						{
+							player.inventory = next;
+							player.score += brew.price + bonus(i);
+							player.brewCount++;
+							brewed[p] = static_cast<int>(i);
+						}
+					}
+				}
+				else if (type == Object::RoundActionCast)
+				{
+					for (auto &spell : player.spells)
+					{
+						if (spell.actionId != id || !spell.castable || times < 1 || (times > 1 && !spell.repeatable))
+							continue;
+						const auto next = add(player.inventory, spell.delta, times);
+						if (accept(next))
+						{
+							player.inventory = next;
+							spell.castable = false;
+						}
+					}
+				}
+				else if (type == Object::RoundActionLearn)
+				{
+					forange(i, tomes.size())
+					{
+						const auto &learn = LearnSpell[tomes[i].learnIndex];
+						if (learn.actionId != id || player.inventory[0] < static_cast<int>(i))
+							continue;
+
+						player.inventory[0] -= static_cast<int>(i);
+						const auto room = Object::InventorySize - std::accumulate(player.inventory.cbegin(), player.inventory.cend(), 0);
+						player.inventory[0] += std::min(room, tomes[i].tax);
+						player.spells.push_back(Spell{nextActionId++, toInventory(learn.delta), learn.repeatable, true});
+						player.learns.push_back(Learned{tomes[i].learnIndex, turn, static_cast<int>(player.spells.size() - BaseSpellSize) - 1});
+						learned[p] = static_cast<int>(i);
+					}
+				}
+				else if (type == Object::RoundActionRest)
+				{
+					for (auto &spell : player.spells)
+						spell.castable = true;
+				}
+			}
+
+			//取得されたスペルは左側のスペルに税を置いて市場から除く(同じスペルは1回)
+			const auto learnSlot = std::max(learned[0], learned[1]);
+			forange(p, players.size())
+			{
+				forange_type(int, i, std::max(0, learned[p]))
+				{
+					tomes[i].tax++;
+				}
+			}
+			if (learnSlot >= 0)
+			{
+				tomes.erase(tomes.begin() + learnSlot);
+				if (learned[0] >= 0 && learned[1] >= 0 && learned[0] != learned[1])
+					tomes.erase(tomes.begin() + std::min(learned[0], learned[1]));
+				while (tomes.size() < Object::LearnSize && !tomeDeck.empty())
+				{
+					tomes.push_back(Tome{tomeDeck.back(), 0});
+					tomeDeck.pop_back();
+				}
+			}
+
+			//作成されたポーションのボーナスを減らして市場から除く
+			const auto brewSlot = std::max(brewed[0], brewed[1]);
+			if (brewSlot >= 0)
+			{
+				std::vector<int> slots;
+				forange(p, brewed.size())
+				{
+					if (brewed[p] >= 0 && std::find(slots.begin(), slots.end(), brewed[p]) == slots.end())
+						slots.push_back(brewed[p]);
+				}
+				std::sort(slots.rbegin(), slots.rend());
+				for (const auto slot : slots)
+				{
+					useBonus(static_cast<size_t>(slot));
+					brews.erase(brews.begin() + slot);
+				}
+				while (brews.size() < Object::BrewSize && !brewDeck.empty())
+				{
+					brews.push_back(brewDeck.back());
+					brewDeck.pop_back();
+				}
+			}
+
+			turn++;
+		}
+
+		bool finished() const
+		{
+			return turn >= TurnLimit || players[0].brewCount >= Object::PotionLimit || players[1].brewCount >= Object::PotionLimit;
+		}
+
+		const Player &player(const size_t p) const
+		{
+			return players[p];
+		}
+	};
+
+	/**
+	 * @brief 1ゲームを対戦する
+	 *
+	 * @param log 先手への入力を追記する(nullptrの場合は記録しない)
+	 */
+	Game play(std::mt19937 &engine, const size_t nodes, const uint64_t seed, std::string *log = nullptr)
+	{
+		Game game(engine);
+
+		std::array<std::unique_ptr<Engine>, 2> engines;
+		forange(p, engines.size())
+		{
+			Engine::Option option;
+			option.firstArenaMB = 64;
+			option.arenaMB = 64;
+			option.firstNodes = nodes * 4;
+			option.nodes = nodes;
+			option.surveyNodes = std::max<size_t>(1, nodes / 10);
+			option.useSeed = true;
+			option.seed = seed + p;
+			engines[p] = std::make_unique<Engine>(option);
+		}
+
+		while (!game.finished())
+		{
+			std::array<std::string, 2> commands;
+			forange(p, engines.size())
+			{
+				const auto input = game.input(p);
+				if (log && p == 0)
+					*log += input;
+				std::istringstream iss(input);
+				engines[p]->read(iss);
+				commands[p] = engines[p]->think();
+			}
+			game.play(commands);
+		}
+
+		return game;
+	}
+
+	/**
+	 * @brief 条件ごとのスペル取得の最終得点の集計
+	 *
+	 */
+	struct Tally
+	{
+		std::array<std::array<std::array<double, LearnSpellSize>, OwnedSize>, PhaseSize> sum{};
+		std::array<std::array<std::array<int, LearnSpellSize>, OwnedSize>, PhaseSize> count{};
+
+		void add(const Game &game)
+		{
+			forange(p, 2)
+			{
+				const auto total = game.player(p).total();
+				for (const auto &learn : game.player(p).learns)
+				{
+					const auto phase = phaseOf(learn.turn);
+					const auto owned = ownedOf(learn.owned);
+					sum[phase][owned][learn.spell] += total;
+					count[phase][owned][learn.spell]++;
+				}
+			}
+		}
+	};
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	size_t gameCount = 200;
+	unsigned int seed = 0;
+	size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	size_t nodes = 2000;
+	bool logOnly = false;
+
+	forstep_type(int, i, 1, argc)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--log")
+		{
+			logOnly = true;
+			continue;
+		}
+		if (i + 1 >= argc || (arg != "-g" && arg != "-s" && arg != "-j" && arg != "-n"))
+			continue;
+
+		unsigned long long value = 0;
+		if (!parseNumber(argv[++i], value))
+		{
+			std::clog << "数値ではない引数です:" << arg << " " << argv[i] << std::endl;
+			return 2;
+		}
+
+		if (arg == "-g")
+			gameCount = value;
+		else if (arg == "-s")
+			seed = static_cast<unsigned int>(value);
+		else if (arg == "-j")
+			threadCount = std::max<size_t>(1, value);
+		else
+			nodes = std::max<size_t>(1, value);
+	}
+
+	//探索のログは捨てる(進捗はstd::clogに出力する)
+	std::cerr.rdbuf(nullptr);
+
+	if (logOnly)
+	{
+		//集計の1対戦目と同じ盤面と乱数
+		std::mt19937 engine(seed * 1000003u);
+		std::string log;
+		const auto game = play(engine, nodes, seed, &log);
+		std::cout << log;
+		std::clog << "score " << game.player(0).total() << " - " << game.player(1).total() << std::endl;
+		return 0;
+	}
+
+	Tally tally;
+	size_t finished = 0;
+	std::mutex mutex;
+	std::atomic<size_t> next{0};
+
+	const auto worker = [&]() {
+		while (true)
+		{
+			const auto index = next++;
+			if (index >= gameCount)
+				break;
+
+			//対戦ごとに盤面と乱数を固定する
+			std::mt19937 engine(seed * 1000003u + static_cast<unsigned int>(index));
+			const auto game = play(engine, nodes, seed + index);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			tally.add(game);
+			finished++;
+			std::clog << "@" << finished << "/" << gameCount << std::endl;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	forange(i, std::min(threadCount, gameCount))
+	{
+		threads.emplace_back(worker);
+	}
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	forange(phase, PhaseSize)
+	{
+		std::string line = "\t\t{";
+		forange(owned, OwnedSize)
+		{
+			const auto &sum = tally.sum[phase][owned];
+			const auto &count = tally.count[phase][owned];
+
+			const auto total = std::accumulate(count.cbegin(), count.cend(), 0);
+			const auto mean = (total > 0 ? std::accumulate(sum.cbegin(), sum.cend(), 0.0) / total : 0.0);
+
+			line += "{";
+			forange(spell, LearnSpellSize)
+			{
+				//同じ条件の平均に寄せた平均との差
+				const auto value = (sum[spell] + Prior * mean) / (count[spell] + Prior) - mean;
+				const auto scaled = std::clamp(static_cast<int>(std::lround(value * Scale)), -32767, 32767);
+				line += std::to_string(scaled) + (spell + 1 < LearnSpellSize ? ", " : "");
+			}
+			line += (owned + 1 < OwnedSize ? "}, " : "}");
+		}
+		line += "},";
+
+		std::cout << line << std::endl;
+	}
+
+	return 0;
+}